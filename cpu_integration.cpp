@@ -0,0 +1,928 @@
+#include "cpu_integration.hpp"
+#include "double_pendulum_dots.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+static const double PI = 3.141592653589793;
+
+template <typename S>
+void CoordArrays<S>::resize(size_t size) {
+    this->size = size;
+    size_t padded = this->padded_size();
+    this->pi1.assign(padded, 0.0);
+    this->pi2.assign(padded, 0.0);
+    this->phi1.assign(padded, 0.0);
+    this->phi2.assign(padded, 0.0);
+}
+
+template <typename S>
+size_t CoordArrays<S>::padded_size() const {
+    return PADDING*((this->size + PADDING - 1)/PADDING);
+}
+
+template <typename S>
+void CoordArrays<S>::swap(size_t i, size_t j) {
+    std::swap(this->pi1[i], this->pi1[j]);
+    std::swap(this->pi2[i], this->pi2[j]);
+    std::swap(this->phi1[i], this->phi1[j]);
+    std::swap(this->phi2[i], this->phi2[j]);
+}
+
+template <typename S>
+static CoordPointers<S> pointers(CoordArrays<S> &a) {
+    return {
+        .pi1=a.pi1.data(), .pi2=a.pi2.data(),
+        .phi1=a.phi1.data(), .phi2=a.phi2.data()
+    };
+}
+
+template <Integrator M>
+struct MethodTag {};
+
+/* The coordinates of a register's worth of pendulums, so that the many
+linear combinations of the stages of the higher order methods can be
+written out as they appear in their tableaus. */
+template <typename V>
+struct CoordVector {
+    typedef typename SIMDTraits<V>::scalar S;
+    V pi1, pi2, phi1, phi2;
+    SIMD_INLINE CoordVector<V> operator+(const CoordVector<V> &b) const {
+        return {pi1 + b.pi1, pi2 + b.pi2, phi1 + b.phi1, phi2 + b.phi2};
+    }
+    SIMD_INLINE CoordVector<V> operator-(const CoordVector<V> &b) const {
+        return {pi1 - b.pi1, pi2 - b.pi2, phi1 - b.phi1, phi2 - b.phi2};
+    }
+    SIMD_INLINE friend CoordVector<V> operator*(
+        S a, const CoordVector<V> &b) {
+        return {a*b.pi1, a*b.pi2, a*b.phi1, a*b.phi2};
+    }
+    /* Every lane scaled by the matching lane of h. */
+    SIMD_INLINE CoordVector<V> times(const V &h) const {
+        return {h*pi1, h*pi2, h*phi1, h*phi2};
+    }
+    SIMD_INLINE static CoordVector<V> load(
+        const CoordPointers<S> &p, size_t i) {
+        return {simd_load<V>(p.pi1 + i), simd_load<V>(p.pi2 + i),
+                simd_load<V>(p.phi1 + i), simd_load<V>(p.phi2 + i)};
+    }
+    SIMD_INLINE void store(const CoordPointers<S> &p, size_t i) const {
+        simd_store<V>(p.pi1 + i, pi1);
+        simd_store<V>(p.pi2 + i, pi2);
+        simd_store<V>(p.phi1 + i, phi1);
+        simd_store<V>(p.phi2 + i, phi2);
+    }
+    /* Write the lanes of the pendulums below size to dst as interleaved
+    floats, which is the layout of the textures. */
+    SIMD_INLINE void store_interleaved(
+        float *dst, size_t i, size_t size) const {
+        const S *lanes[4] = {
+            (const S *)&pi1, (const S *)&pi2,
+            (const S *)&phi1, (const S *)&phi2
+        };
+        for (int j = 0; j < SIMDTraits<V>::WIDTH && i + j < size; j++)
+            for (int k = 0; k < 4; k++)
+                dst[4*(i + j) + k] = lanes[k][j];
+    }
+    SIMD_INLINE static CoordVector<V> select(
+        const typename SIMDTraits<V>::mask &m,
+        const CoordVector<V> &a, const CoordVector<V> &b) {
+        return {simd_select<V>(m, a.pi1, b.pi1),
+                simd_select<V>(m, a.pi2, b.pi2),
+                simd_select<V>(m, a.phi1, b.phi1),
+                simd_select<V>(m, a.phi2, b.phi2)};
+    }
+};
+
+template <typename V, typename K>
+SIMD_INLINE CoordVector<V> double_pendulum_dots(
+    const CoordVector<V> &q, const K &k) {
+    CoordVector<V> d;
+    double_pendulum_dots<V>(
+        d.pi1, d.pi2, d.phi1, d.phi2, q.pi1, q.pi2, q.phi1, q.phi2, k);
+    return d;
+}
+
+template <typename V>
+SIMD_INLINE V simd_abs(const V &x) {
+    typedef typename SIMDTraits<V>::mask M;
+    M negative = (x < V{});
+    return simd_select<V>(negative, -x, x);
+}
+
+template <typename V>
+SIMD_INLINE V simd_max(const V &a, const V &b) {
+    typedef typename SIMDTraits<V>::mask M;
+    M greater = (a > b);
+    return simd_select<V>(greater, a, b);
+}
+
+/* Give the lanes where either arm is past the top for the first time the
+flip time t, and return whether every lane has flipped. */
+template <typename V>
+SIMD_INLINE bool record_flips(
+    const V &phi1, const V &phi2, const V &t, V &flip_time) {
+    typedef typename SIMDTraits<V>::scalar S;
+    typedef typename SIMDTraits<V>::mask M;
+    const V zero = V{}, pi = zero + S(PI);
+    M over_the_top = (simd_abs(phi1) > pi) | (simd_abs(phi2) > pi);
+    M pending = (flip_time == zero);
+    flip_time = simd_select<V>(over_the_top & pending, t, flip_time);
+    pending = (flip_time == zero);
+    return !simd_any<V>(pending);
+}
+
+/* Advance the pendulums in [begin, end) by a number of RK4 steps. One
+register's worth of pendulums at a time is loaded, taken through every stage
+of every step without leaving registers, then written back, so that the only
+memory traffic is a single read and write of the state per call. */
+template <typename V, typename K>
+SIMD_INLINE void double_pendulum_range(
+    const KernelArgs<typename SIMDTraits<V>::scalar> &args,
+    size_t begin, size_t end, MethodTag<INTEGRATOR_RK4>) {
+    typedef typename SIMDTraits<V>::scalar S;
+    const CoordPointers<S> q = args.coords;
+    const K k(args.params);
+    const size_t width = SIMDTraits<V>::WIDTH;
+    const int steps = args.steps;
+    const S two = 2.0, half_dt = args.dt/2.0, sixth_dt = args.dt/6.0;
+    const S step_dt = args.dt;
+    const double abs_dt = std::abs(args.dt);
+    for (size_t i = begin; i < end; i += width) {
+        V pi1 = simd_load<V>(q.pi1 + i), pi2 = simd_load<V>(q.pi2 + i);
+        V phi1 = simd_load<V>(q.phi1 + i), phi2 = simd_load<V>(q.phi2 + i);
+        V flip_time = V{};
+        if (args.flip_times != NULL)
+            flip_time = simd_load<V>(args.flip_times + i);
+        for (int step = 0; step < steps; step++) {
+            V d_pi1, d_pi2, d_phi1, d_phi2;
+            V s_pi1, s_pi2, s_phi1, s_phi2;
+            // q1
+            double_pendulum_dots<V>(
+                d_pi1, d_pi2, d_phi1, d_phi2, pi1, pi2, phi1, phi2, k);
+            s_pi1 = d_pi1, s_pi2 = d_pi2, s_phi1 = d_phi1, s_phi2 = d_phi2;
+            // q2
+            double_pendulum_dots<V>(
+                d_pi1, d_pi2, d_phi1, d_phi2,
+                pi1 + half_dt*d_pi1, pi2 + half_dt*d_pi2,
+                phi1 + half_dt*d_phi1, phi2 + half_dt*d_phi2, k);
+            s_pi1 += two*d_pi1, s_pi2 += two*d_pi2;
+            s_phi1 += two*d_phi1, s_phi2 += two*d_phi2;
+            // q3
+            double_pendulum_dots<V>(
+                d_pi1, d_pi2, d_phi1, d_phi2,
+                pi1 + half_dt*d_pi1, pi2 + half_dt*d_pi2,
+                phi1 + half_dt*d_phi1, phi2 + half_dt*d_phi2, k);
+            s_pi1 += two*d_pi1, s_pi2 += two*d_pi2;
+            s_phi1 += two*d_phi1, s_phi2 += two*d_phi2;
+            // q4
+            double_pendulum_dots<V>(
+                d_pi1, d_pi2, d_phi1, d_phi2,
+                pi1 + step_dt*d_pi1, pi2 + step_dt*d_pi2,
+                phi1 + step_dt*d_phi1, phi2 + step_dt*d_phi2, k);
+            pi1 += sixth_dt*(s_pi1 + d_pi1);
+            pi2 += sixth_dt*(s_pi2 + d_pi2);
+            phi1 += sixth_dt*(s_phi1 + d_phi1);
+            phi2 += sixth_dt*(s_phi2 + d_phi2);
+            if (args.flip_times != NULL
+                && record_flips<V>(
+                    phi1, phi2, V{} + S(args.time + (step + 1)*abs_dt),
+                    flip_time))
+                break;
+        }
+        if (args.flip_times != NULL)
+            simd_store<V>(args.flip_times + i, flip_time);
+        simd_store<V>(q.pi1 + i, pi1);
+        simd_store<V>(q.pi2 + i, pi2);
+        simd_store<V>(q.phi1 + i, phi1);
+        simd_store<V>(q.phi2 + i, phi2);
+        if (args.display != NULL)
+            CoordVector<V>{pi1, pi2, phi1, phi2}.store_interleaved(
+                args.display, i, args.size);
+    }
+}
+
+/* Squared RMS norm of the error estimate e, relative to the tolerance
+scaled by the larger of the coordinates before and after the step. */
+template <typename V>
+SIMD_INLINE V error_norm2(
+    const CoordVector<V> &e, const CoordVector<V> &y0,
+    const CoordVector<V> &y1, typename SIMDTraits<V>::scalar tolerance) {
+    typedef typename SIMDTraits<V>::scalar S;
+    V pi1 = e.pi1/(tolerance
+                   + tolerance*simd_max(simd_abs(y0.pi1), simd_abs(y1.pi1)));
+    V pi2 = e.pi2/(tolerance
+                   + tolerance*simd_max(simd_abs(y0.pi2), simd_abs(y1.pi2)));
+    V phi1 = e.phi1/(tolerance
+                     + tolerance*simd_max(simd_abs(y0.phi1),
+                                          simd_abs(y1.phi1)));
+    V phi2 = e.phi2/(tolerance
+                     + tolerance*simd_max(simd_abs(y0.phi2),
+                                          simd_abs(y1.phi2)));
+    return S(0.25)*(pi1*pi1 + pi2*pi2 + phi1*phi1 + phi2*phi2);
+}
+
+/* Advance the pendulums in [begin, end) by steps*dt with the
+Dormand-Prince 5(4) pair, using the step size control and the dense output
+of Hairer's DOPRI5. Every lane keeps taking steps of its own size until its
+local time passes the end of the interval, and on the step that crosses it
+the continuous extension gives the coordinates at exactly the end, which
+is what gets displayed. The local times are stored as offsets from the end
+of the last interval, so that they stay small enough for single precision.
+Lanes whose local time is already past the end of the interval, because of
+a long step on an earlier call, keep their last interpolated coordinates
+until the display catches up with them. A tile keeps iterating until all of
+its lanes are done, so the lanes in easy regions idle along with a chaotic
+neighbour, but the rest of the grid is not held back. */
+template <typename V, typename K>
+SIMD_INLINE void double_pendulum_range(
+    const KernelArgs<typename SIMDTraits<V>::scalar> &args,
+    size_t begin, size_t end, MethodTag<INTEGRATOR_DOPRI5>) {
+    typedef typename SIMDTraits<V>::scalar S;
+    typedef typename SIMDTraits<V>::mask M;
+    typedef CoordVector<V> C;
+    // Nodes are c2 = 1/5, c3 = 3/10, c4 = 4/5, c5 = 8/9 and c6 = c7 = 1,
+    // and they only matter for non-autonomous systems.
+    const S A21 = 1.0/5.0;
+    const S A31 = 3.0/40.0, A32 = 9.0/40.0;
+    const S A41 = 44.0/45.0, A42 = -56.0/15.0, A43 = 32.0/9.0;
+    const S A51 = 19372.0/6561.0, A52 = -25360.0/2187.0;
+    const S A53 = 64448.0/6561.0, A54 = -212.0/729.0;
+    const S A61 = 9017.0/3168.0, A62 = -355.0/33.0, A63 = 46732.0/5247.0;
+    const S A64 = 49.0/176.0, A65 = -5103.0/18656.0;
+    const S B1 = 35.0/384.0, B3 = 500.0/1113.0, B4 = 125.0/192.0;
+    const S B5 = -2187.0/6784.0, B6 = 11.0/84.0;
+    // Difference between the fifth and fourth order weights.
+    const S E1 = 71.0/57600.0, E3 = -71.0/16695.0, E4 = 71.0/1920.0;
+    const S E5 = -17253.0/339200.0, E6 = 22.0/525.0, E7 = -1.0/40.0;
+    // Dense output.
+    const S D1 = -12715105075.0/11282082432.0;
+    const S D3 = 87487479700.0/32700410799.0;
+    const S D4 = -10690763975.0/1880347072.0;
+    const S D5 = 701980252875.0/199316789632.0;
+    const S D6 = -1453857185.0/822651844.0;
+    const S D7 = 69997945.0/29380423.0;
+    // Shrink and grow the step by at most these factors, and never take
+    // steps smaller than MIN_STEP*|dt|, which are accepted regardless of
+    // the error so that no pendulum can stall the grid.
+    const S SAFETY = 0.9, MIN_FACTOR = 0.2, MAX_FACTOR = 5.0;
+    const S MIN_STEP = 1e-3;
+    const int MAX_ITERATIONS = 100000;
+    const K k(args.params);
+    const size_t width = SIMDTraits<V>::WIDTH;
+    const S interval = args.dt*args.steps;
+    const S direction = (interval < 0.0)? -1.0: 1.0;
+    const S length = direction*interval;
+    const S min_step = MIN_STEP*length/args.steps;
+    const S tolerance = args.tolerance;
+    const V zero = V{}, one = zero + S(1.0);
+    // The local time of a lane since init_config is end + offset.
+    const V end_time = zero + S(args.time + length);
+    for (size_t i = begin; i < end; i += width) {
+        C q = C::load(args.coords, i);
+        C out = C::load(args.dense_coords, i);
+        V h = simd_load<V>(args.step_sizes + i);
+        V offset = simd_load<V>(args.time_offsets + i) - length;
+        V flip_time = zero;
+        if (args.flip_times != NULL)
+            flip_time = simd_load<V>(args.flip_times + i);
+        C k1 = double_pendulum_dots<V>(q, k);
+        M active = (offset < zero);
+        if (args.flip_times != NULL) {
+            M pending = (flip_time == zero);
+            active = active & pending;
+        }
+        for (int iteration = 0; simd_any<V>(active)
+                 && iteration < MAX_ITERATIONS; iteration++) {
+            M too_long = (h > length);
+            h = simd_select<V>(too_long, zero + length, h);
+            V hd = direction*h;
+            C k2 = double_pendulum_dots<V>(q + (A21*k1).times(hd), k);
+            C k3 = double_pendulum_dots<V>(
+                q + (A31*k1 + A32*k2).times(hd), k);
+            C k4 = double_pendulum_dots<V>(
+                q + (A41*k1 + A42*k2 + A43*k3).times(hd), k);
+            C k5 = double_pendulum_dots<V>(
+                q + (A51*k1 + A52*k2 + A53*k3 + A54*k4).times(hd), k);
+            C k6 = double_pendulum_dots<V>(
+                q + (A61*k1 + A62*k2 + A63*k3 + A64*k4
+                     + A65*k5).times(hd), k);
+            C y = q + (B1*k1 + B3*k3 + B4*k4 + B5*k5 + B6*k6).times(hd);
+            // First stage of the next step.
+            C k7 = double_pendulum_dots<V>(y, k);
+            C e = (E1*k1 + E3*k3 + E4*k4 + E5*k5 + E6*k6
+                   + E7*k7).times(hd);
+            V err2 = error_norm2(e, q, y, tolerance);
+            // Lanes that have blown up, like those that reach a singular
+            // point of the equations, are carried along with the longest
+            // steps instead of holding up the rest of their tile.
+            M blown_up = (err2 != err2);
+            M within_tolerance = (err2 <= one);
+            M at_min_step = (h <= min_step);
+            M accept = active & (within_tolerance | at_min_step | blown_up);
+            M crossing = (offset + h >= zero);
+            crossing = crossing & accept;
+            if (simd_any<V>(crossing)) {
+                V theta = -offset/h, theta1 = one - theta;
+                C y_diff = y - q;
+                C b_spline = k1.times(hd) - y_diff;
+                C r4 = y_diff - k7.times(hd) - b_spline;
+                C r5 = (D1*k1 + D3*k3 + D4*k4 + D5*k5 + D6*k6
+                        + D7*k7).times(hd);
+                C dense = q + (y_diff + (b_spline + (r4 + r5.times(theta1))
+                                         .times(theta)).times(theta1))
+                              .times(theta);
+                out = C::select(crossing, dense, out);
+            }
+            q = C::select(accept, y, q);
+            k1 = C::select(accept, k7, k1);
+            offset = simd_select<V>(accept, offset + h, offset);
+            // err2 is zero for exact steps, which gives an infinite factor.
+            V factor = SAFETY*simd_pow<V>(err2, S(-0.1));
+            M too_small = (factor < MIN_FACTOR);
+            factor = simd_select<V>(too_small, zero + MIN_FACTOR, factor);
+            M too_large = (factor > MAX_FACTOR);
+            too_large = too_large | blown_up;
+            factor = simd_select<V>(too_large, zero + MAX_FACTOR, factor);
+            M growing = (factor > one);
+            M rejected = (accept == 0);
+            M rejected_growth = growing & rejected;
+            factor = simd_select<V>(rejected_growth, one, factor);
+            h = simd_select<V>(active, h*factor, h);
+            M below_min_step = (h < min_step);
+            h = simd_select<V>(below_min_step, zero + min_step, h);
+            active = (offset < zero);
+            if (args.flip_times != NULL) {
+                // The lanes that were not accepted were already checked.
+                record_flips<V>(q.phi1, q.phi2, end_time + offset, flip_time);
+                M pending = (flip_time == zero);
+                active = active & pending;
+            }
+        }
+        if (args.flip_times != NULL)
+            simd_store<V>(args.flip_times + i, flip_time);
+        q.store(args.coords, i);
+        out.store(args.dense_coords, i);
+        if (args.display != NULL)
+            out.store_interleaved(args.display, i, args.size);
+        simd_store<V>(args.step_sizes + i, h);
+        simd_store<V>(args.time_offsets + i, offset);
+    }
+}
+
+/* Largest of the coordinates of q in magnitude, for every lane. */
+template <typename V>
+SIMD_INLINE V max_abs(const CoordVector<V> &q) {
+    return simd_max(simd_max(simd_abs(q.pi1), simd_abs(q.pi2)),
+                    simd_max(simd_abs(q.phi1), simd_abs(q.phi2)));
+}
+
+/* Advance the pendulums in [begin, end) by a number of steps of the two
+stage Gauss-Legendre method. The stages of each step are found by fixed
+point iteration, starting from the stages of the previous step, until they
+stop changing to within a few ulps. This converges as long as dt is small
+compared to the time scale of the motion, which is still far larger than
+the time steps that explicit methods need to keep the energy from
+drifting. */
+template <typename V, typename K>
+SIMD_INLINE void double_pendulum_range(
+    const KernelArgs<typename SIMDTraits<V>::scalar> &args,
+    size_t begin, size_t end, MethodTag<INTEGRATOR_GAUSS_LEGENDRE>) {
+    typedef typename SIMDTraits<V>::scalar S;
+    typedef typename SIMDTraits<V>::mask M;
+    typedef CoordVector<V> C;
+    const S A11 = 0.25, A12 = 0.25 - 0.28867513459481288225;
+    const S A21 = 0.25 + 0.28867513459481288225, A22 = 0.25;
+    const int MAX_ITERATIONS = 20;
+    const S EPSILON = 16.0*std::numeric_limits<S>::epsilon();
+    const K k(args.params);
+    const size_t width = SIMDTraits<V>::WIDTH;
+    const S dt = args.dt, half_dt = args.dt/2.0;
+    const S abs_dt = (dt < 0.0)? -dt: dt;
+    const V one = V{} + S(1.0);
+    for (size_t i = begin; i < end; i += width) {
+        C q = C::load(args.coords, i);
+        C k1 = double_pendulum_dots<V>(q, k), k2 = k1;
+        V flip_time = V{};
+        if (args.flip_times != NULL)
+            flip_time = simd_load<V>(args.flip_times + i);
+        for (int step = 0; step < args.steps; step++) {
+            V threshold = EPSILON*(one + max_abs(q));
+            for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++) {
+                C next_k1 = double_pendulum_dots<V>(
+                    q + dt*(A11*k1 + A12*k2), k);
+                C next_k2 = double_pendulum_dots<V>(
+                    q + dt*(A21*k1 + A22*k2), k);
+                V change = abs_dt*(max_abs(next_k1 - k1)
+                                   + max_abs(next_k2 - k2));
+                k1 = next_k1, k2 = next_k2;
+                // Lanes that blow up never converge, and stop the
+                // iteration as well.
+                M converged = (change <= threshold);
+                M blown_up = (change != change);
+                M unconverged = ((converged | blown_up) == 0);
+                if (!simd_any<V>(unconverged))
+                    break;
+            }
+            q = q + half_dt*(k1 + k2);
+            if (args.flip_times != NULL
+                && record_flips<V>(
+                    q.phi1, q.phi2, V{} + S(args.time + (step + 1)*abs_dt),
+                    flip_time))
+                break;
+        }
+        if (args.flip_times != NULL)
+            simd_store<V>(args.flip_times + i, flip_time);
+        q.store(args.coords, i);
+        if (args.display != NULL)
+            q.store_interleaved(args.display, i, args.size);
+    }
+}
+
+/* The flows of Tao's extended phase space method, where q holds the
+coordinates of the first copy of the pendulums and e those of the second.
+The Hamiltonian is split into H(phi, pi_e) + H(phi_e, pi) plus a binding
+term, and the flows of each of these three parts can be solved exactly. */
+template <typename V, typename K>
+SIMD_INLINE void extended_flow_a(
+    CoordVector<V> &q, CoordVector<V> &e,
+    typename SIMDTraits<V>::scalar d, const K &k) {
+    CoordVector<V> f = double_pendulum_dots<V>(
+        CoordVector<V>{e.pi1, e.pi2, q.phi1, q.phi2}, k);
+    q.pi1 += d*f.pi1, q.pi2 += d*f.pi2;
+    e.phi1 += d*f.phi1, e.phi2 += d*f.phi2;
+}
+
+template <typename V, typename K>
+SIMD_INLINE void extended_flow_b(
+    CoordVector<V> &q, CoordVector<V> &e,
+    typename SIMDTraits<V>::scalar d, const K &k) {
+    CoordVector<V> f = double_pendulum_dots<V>(
+        CoordVector<V>{q.pi1, q.pi2, e.phi1, e.phi2}, k);
+    q.phi1 += d*f.phi1, q.phi2 += d*f.phi2;
+    e.pi1 += d*f.pi1, e.pi2 += d*f.pi2;
+}
+
+/* Rotates the difference between the two copies by the angle whose cosine
+and sine are given, while keeping their sum fixed. */
+template <typename V>
+SIMD_INLINE void extended_flow_c(
+    CoordVector<V> &q, CoordVector<V> &e,
+    typename SIMDTraits<V>::scalar cos_angle,
+    typename SIMDTraits<V>::scalar sin_angle) {
+    typedef typename SIMDTraits<V>::scalar S;
+    CoordVector<V> sum = q + e, diff = q - e;
+    CoordVector<V> rotated = {
+        cos_angle*diff.pi1 - sin_angle*diff.phi1,
+        cos_angle*diff.pi2 - sin_angle*diff.phi2,
+        cos_angle*diff.phi1 + sin_angle*diff.pi1,
+        cos_angle*diff.phi2 + sin_angle*diff.pi2
+    };
+    q = S(0.5)*(sum + rotated);
+    e = S(0.5)*(sum - rotated);
+}
+
+/* Advance the pendulums in [begin, end) by a number of steps of Tao's
+explicit symplectic method for non-separable Hamiltonians, using the second
+order Strang splitting A(h/2) B(h/2) C(h) B(h/2) A(h/2) composed by the
+triple jump of Yoshida into a fourth order method. Consecutive flows of A
+within a step are merged, which leaves 10 evaluations of the derivatives per
+step. Each step starts with both copies equal to the pendulum, and ends
+with their mean, which is one of the projections of Pihajoki. This makes
+the method only approximately symplectic, but left to themselves the copies
+of the chaotic pendulums drift apart within seconds whatever the binding,
+and their energy with them.
+
+References:
+    Molei Tao, Explicit symplectic approximation of nonseparable
+    Hamiltonians: algorithm and long time performance, Phys. Rev. E 94,
+    043303 (2016).
+
+    Pauli Pihajoki, Explicit methods in extended phase space for
+    inseparable Hamiltonian problems, Celest. Mech. Dyn. Astr. 121,
+    211-231 (2015).
+*/
+template <typename V, typename K>
+SIMD_INLINE void double_pendulum_range(
+    const KernelArgs<typename SIMDTraits<V>::scalar> &args,
+    size_t begin, size_t end, MethodTag<INTEGRATOR_EXTENDED_PHASE_SPACE>) {
+    typedef typename SIMDTraits<V>::scalar S;
+    typedef CoordVector<V> C;
+    const double GAMMA1 = 1.0/(2.0 - 1.25992104989487316477);
+    const double GAMMA2 = 1.0 - 2.0*GAMMA1;
+    const K k(args.params);
+    const size_t width = SIMDTraits<V>::WIDTH;
+    const double dt = args.dt;
+    const double angle = 2.0*EXTENDED_PHASE_SPACE_BINDING*dt;
+    const S a1 = 0.5*GAMMA1*dt, a12 = 0.5*(GAMMA1 + GAMMA2)*dt;
+    const S b1 = 0.5*GAMMA1*dt, b2 = 0.5*GAMMA2*dt;
+    const S cos1 = cos(GAMMA1*angle), sin1 = sin(GAMMA1*angle);
+    const S cos2 = cos(GAMMA2*angle), sin2 = sin(GAMMA2*angle);
+    const double abs_dt = std::abs(dt);
+    for (size_t i = begin; i < end; i += width) {
+        C q = C::load(args.coords, i);
+        V flip_time = V{};
+        if (args.flip_times != NULL)
+            flip_time = simd_load<V>(args.flip_times + i);
+        for (int step = 0; step < args.steps; step++) {
+            C e = q;
+            extended_flow_a<V>(q, e, a1, k);
+            extended_flow_b<V>(q, e, b1, k);
+            extended_flow_c<V>(q, e, cos1, sin1);
+            extended_flow_b<V>(q, e, b1, k);
+            extended_flow_a<V>(q, e, a12, k);
+            extended_flow_b<V>(q, e, b2, k);
+            extended_flow_c<V>(q, e, cos2, sin2);
+            extended_flow_b<V>(q, e, b2, k);
+            extended_flow_a<V>(q, e, a12, k);
+            extended_flow_b<V>(q, e, b1, k);
+            extended_flow_c<V>(q, e, cos1, sin1);
+            extended_flow_b<V>(q, e, b1, k);
+            extended_flow_a<V>(q, e, a1, k);
+            q = S(0.5)*(q + e);
+            if (args.flip_times != NULL
+                && record_flips<V>(
+                    q.phi1, q.phi2, V{} + S(args.time + (step + 1)*abs_dt),
+                    flip_time))
+                break;
+        }
+        if (args.flip_times != NULL)
+            simd_store<V>(args.flip_times + i, flip_time);
+        q.store(args.coords, i);
+        if (args.display != NULL)
+            q.store_interleaved(args.display, i, args.size);
+    }
+}
+
+/* K is one of the DotsConstants types of double_pendulum_dots.hpp. */
+template <Integrator M, typename K>
+static void double_pendulum_128(
+    const KernelArgs<typename K::scalar> &args, size_t begin, size_t end) {
+    double_pendulum_range<typename SIMDVectors<typename K::scalar>::v128, K>(
+        args, begin, end, MethodTag<M>());
+}
+
+#if SIMD_X86
+template <Integrator M, typename K>
+SIMD_TARGET("avx2,fma")
+static void double_pendulum_avx2(
+    const KernelArgs<typename K::scalar> &args, size_t begin, size_t end) {
+    double_pendulum_range<typename SIMDVectors<typename K::scalar>::v256, K>(
+        args, begin, end, MethodTag<M>());
+}
+
+template <Integrator M, typename K>
+SIMD_TARGET("avx512f")
+static void double_pendulum_avx512(
+    const KernelArgs<typename K::scalar> &args, size_t begin, size_t end) {
+    double_pendulum_range<typename SIMDVectors<typename K::scalar>::v512, K>(
+        args, begin, end, MethodTag<M>());
+}
+#endif
+
+/* Widest kernel of the method M using the constants K supported by the
+running machine. Only instantiated for the precisions that are actually
+selected. */
+template <typename S>
+template <Integrator M, typename K>
+typename CPUIntegration::State<S>::Kernel
+CPUIntegration::State<S>::widest_kernel(SIMDLevel level) {
+    #if SIMD_X86
+    // There are no vectors of long double, so wider ISAs would not help.
+    if (sizeof(S) > sizeof(double))
+        return double_pendulum_128<M, K>;
+    if (level == SIMD_AVX512)
+        return double_pendulum_avx512<M, K>;
+    else if (level == SIMD_AVX2)
+        return double_pendulum_avx2<M, K>;
+    #endif
+    return double_pendulum_128<M, K>;
+}
+
+/* The kernels are laid out by method, then by DotsPreset. */
+template <typename S>
+template <Integrator M>
+void CPUIntegration::State<S>::select_kernels(SIMDLevel level) {
+    Kernel *kernels = &this->kernels[M*DOTS_PRESET_COUNT];
+    kernels[DOTS_GENERIC]
+        = widest_kernel<M, DotsConstants<S>>(level);
+    kernels[DOTS_UNIT]
+        = widest_kernel<M, UnitDotsConstants<S>>(level);
+    kernels[DOTS_UNIT_LENGTH]
+        = widest_kernel<M, UnitLengthDotsConstants<S>>(level);
+}
+
+template <typename S>
+void CPUIntegration::State<S>::select_kernels(SIMDLevel level) {
+    this->kernels.resize(INTEGRATOR_COUNT*DOTS_PRESET_COUNT);
+    this->select_kernels<INTEGRATOR_RK4>(level);
+    this->select_kernels<INTEGRATOR_GAUSS_LEGENDRE>(level);
+    this->select_kernels<INTEGRATOR_EXTENDED_PHASE_SPACE>(level);
+    this->select_kernels<INTEGRATOR_DOPRI5>(level);
+}
+
+CPUIntegration::CPUIntegration() {
+    this->simd_level = ::simd_level();
+    this->precision = CPU_DOUBLE;
+    this->integrator = INTEGRATOR_RK4;
+    this->tolerance = 1e-9;
+    this->direction = 1;
+    fprintf(stdout, "CPU integration using %s kernels.\n",
+            simd_level_name(this->simd_level));
+    this->requested_thread_count = -1;
+    this->requested_pinning = false;
+    this->staged = false;
+    this->flip_mode = false;
+    this->time = 0.0;
+    this->flip_times_changed = false;
+    this->set_threads(0, false);
+}
+
+void CPUIntegration::set_threads(int thread_count, bool pin) {
+    if (thread_count == this->requested_thread_count
+        && pin == this->requested_pinning)
+        return;
+    this->pool.reset();
+    this->pool.reset(new ThreadPool(thread_count, pin));
+    this->requested_thread_count = thread_count;
+    this->requested_pinning = pin;
+    fprintf(stdout, "CPU integration using %d thread(s).\n",
+            this->pool->size());
+}
+
+/* The first size pendulums are split into chunks, several per thread so
+that threads which finish early can steal work from slower ones. Without
+the flip time mode, these are bands of rows of the grid. */
+template <typename S>
+size_t CPUIntegration::chunk_count(size_t size) const {
+    size_t chunks_per_thread = 8;
+    size_t count = chunks_per_thread*this->pool->size();
+    size_t padding = CoordArrays<S>::PADDING;
+    size_t registers = (size + padding - 1)/padding;
+    return (count < registers)? count: registers;
+}
+
+/* Index range of the pendulums in a chunk, with both ends at a multiple
+of the array padding so that every range only contains whole SIMD
+registers. */
+template <typename S>
+void CPUIntegration::chunk_range(
+    size_t size, size_t chunk, size_t &begin, size_t &end) const {
+    size_t count = this->chunk_count<S>(size);
+    size_t padding = CoordArrays<S>::PADDING;
+    size_t registers = (size + padding - 1)/padding;
+    begin = padding*((chunk*registers)/count);
+    end = padding*(((chunk + 1)*registers)/count);
+}
+
+template <typename S>
+void CPUIntegration::State<S>::swap(size_t i, size_t j) {
+    this->coords.swap(i, j);
+    if (!this->dense_coords.pi1.empty()) {
+        this->dense_coords.swap(i, j);
+        std::swap(this->step_sizes[i], this->step_sizes[j]);
+        std::swap(this->time_offsets[i], this->time_offsets[j]);
+    }
+    std::swap(this->flip_times[i], this->flip_times[j]);
+    std::swap(this->pixels[i], this->pixels[j]);
+}
+
+/* Move the pendulums that have flipped out of the active slots, by
+swapping each with the last active one, and record their flip times. */
+template <typename S>
+void CPUIntegration::retire_flipped(State<S> &state) {
+    size_t i = 0;
+    while (i < state.active) {
+        if (state.flip_times[i] == S(0.0)) {
+            i++;
+            continue;
+        }
+        this->flip_times[state.pixels[i]] = state.flip_times[i];
+        this->flip_times_changed = true;
+        state.active--;
+        state.swap(i, state.active);
+    }
+}
+
+/* Whether a pendulum starting at rest at the given angles has the energy
+to ever take either of its arms over the top. The least potential energy
+with the inner arm upright is when the outer one hangs down, and with the
+outer arm upright it is when the inner one hangs down. */
+static bool can_flip(
+    const sim_2d::SimParams &params, double phi1, double phi2) {
+    double v1 = (params.mass1 + params.mass2)*params.gravity*params.length1;
+    double v2 = params.mass2*params.gravity*params.length2;
+    double energy = -v1*cos(phi1) - v2*cos(phi2);
+    return energy >= -std::abs(v1 - v2);
+}
+
+template <typename S>
+void CPUIntegration::init_config(State<S> &state, sim_2d::SimParams params) {
+    S min_phi1 = PI*params.minPhi1;
+    S min_phi2 = PI*params.minPhi2;
+    S max_phi1 = PI*params.maxPhi1;
+    S max_phi2 = PI*params.maxPhi2;
+    size_t size = params.gridWidth*params.gridHeight;
+    CoordArrays<S> &coords = state.coords;
+    state.select_kernels(this->simd_level);
+    coords.resize(size);
+    auto initial_phi1 = [&](size_t index) -> S {
+        S u = S(index%params.gridWidth + 0.5)/S(params.gridWidth);
+        return min_phi1 + u*(max_phi1 - min_phi1);
+    };
+    auto initial_phi2 = [&](size_t index) -> S {
+        S v = S(index/params.gridWidth + 0.5)/S(params.gridHeight);
+        return min_phi2 + v*(max_phi2 - min_phi2);
+    };
+    // The pendulums that can never flip are put after the active ones,
+    // so that they are only ever displayed.
+    std::vector<uint32_t> &pixels = state.pixels;
+    pixels.clear();
+    if (this->flip_mode) {
+        std::vector<uint32_t> culled;
+        for (size_t index = 0; index < size; index++) {
+            if (can_flip(params, initial_phi1(index), initial_phi2(index)))
+                pixels.push_back(index);
+            else
+                culled.push_back(index);
+        }
+        state.active = pixels.size();
+        pixels.insert(pixels.end(), culled.begin(), culled.end());
+        state.flip_times.assign(coords.padded_size(), 0.0);
+    }
+    for (size_t slot = 0; slot < size; slot++) {
+        size_t index = (pixels.empty())? slot: pixels[slot];
+        coords.pi1[slot] = 0.0;
+        coords.pi2[slot] = 0.0;
+        coords.phi1[slot] = initial_phi1(index);
+        coords.phi2[slot] = initial_phi2(index);
+    }
+    if (this->integrator == INTEGRATOR_DOPRI5) {
+        state.dense_coords = coords;
+        state.step_sizes.assign(coords.padded_size(), std::abs(params.dt));
+        state.time_offsets.assign(coords.padded_size(), 0.0);
+    }
+}
+
+void CPUIntegration::init_config(sim_2d::SimParams params) {
+    // printf("%d. %d\n", params.gridWidth, params.gridHeight);
+    size_t size = params.gridWidth*params.gridHeight;
+    this->upload.resize(size*4);
+    this->staged = false;
+    this->flip_mode = params.flipTime;
+    this->time = 0.0;
+    this->flip_times.assign((this->flip_mode)? size: 0, 0.0);
+    this->flip_times_changed = this->flip_mode;
+    this->flip_upload.resize((this->flip_mode)? size: 0);
+    this->precision = (CPUPrecision)params.cpuPrecision;
+    this->integrator = (Integrator)params.integrator;
+    if (this->integrator < 0 || this->integrator >= INTEGRATOR_COUNT)
+        this->integrator = INTEGRATOR_RK4;
+    this->direction = (params.dt < 0.0)? -1: 1;
+    this->f32 = State<float>();
+    this->f64 = State<double>();
+    this->f80 = State<long double>();
+    switch(this->precision) {
+        case CPU_FLOAT:
+        this->init_config(this->f32, params);
+        break;
+        case CPU_LONG_DOUBLE:
+        this->init_config(this->f80, params);
+        break;
+        default:
+        this->precision = CPU_DOUBLE;
+        this->init_config(this->f64, params);
+        break;
+    }
+}
+
+void CPUIntegration::set_tolerance(double tolerance) {
+    this->tolerance = tolerance;
+}
+
+template <typename S>
+void CPUIntegration::time_step(
+    State<S> &state, DoublePendulumParams params, double dt, int steps) {
+    size_t size = (this->flip_mode)? state.active: state.coords.size;
+    if (size == 0 || steps <= 0 || dt == 0.0)
+        return;
+    int direction = (dt < 0.0)? -1: 1;
+    if (direction != this->direction) {
+        // A pendulum that was ahead of the display is now behind it.
+        for (auto &offset: state.time_offsets)
+            offset = -offset;
+        this->direction = direction;
+    }
+    // Tolerances near the machine epsilon can never be met, and would
+    // have every pendulum crawl along at the smallest step size.
+    double min_tolerance = 100.0*std::numeric_limits<S>::epsilon();
+    KernelArgs<S> args = {
+        .coords=pointers(state.coords),
+        .dense_coords=pointers(state.dense_coords),
+        .step_sizes=state.step_sizes.data(),
+        .time_offsets=state.time_offsets.data(),
+        .params=params, .dt=dt, .steps=steps,
+        .tolerance=std::max(this->tolerance, min_tolerance),
+        .display=NULL, .size=state.coords.size,
+        .flip_times=NULL, .time=this->time
+    };
+    // The slots of the flip time mode are not in the order of the pixels,
+    // so the pendulums are only written out by transfer_to_quad.
+    if (this->flip_mode)
+        args.flip_times = state.flip_times.data();
+    else
+        args.display = this->upload.map();
+    typename State<S>::Kernel kernel = state.kernels[
+        this->integrator*DOTS_PRESET_COUNT + dots_preset(params)];
+    // Every pendulum is independent of the others, so each band of rows
+    // is taken through all of the steps without waiting on the rest.
+    // Adaptive steps make some bands far more expensive than others,
+    // which work stealing evens out.
+    this->pool->run(this->chunk_count<S>(size), [&](size_t chunk) {
+        size_t begin, end;
+        this->chunk_range<S>(size, chunk, begin, end);
+        kernel(args, begin, end);
+    });
+    this->staged = (args.display != NULL);
+    this->time += steps*std::abs(dt);
+    if (this->flip_mode)
+        this->retire_flipped(state);
+}
+
+void CPUIntegration::time_step(
+    DoublePendulumParams params, double dt, int steps
+) {
+    switch(this->precision) {
+        case CPU_FLOAT:
+        this->time_step(this->f32, params, dt, steps);
+        break;
+        case CPU_LONG_DOUBLE:
+        this->time_step(this->f80, params, dt, steps);
+        break;
+        default:
+        this->time_step(this->f64, params, dt, steps);
+        break;
+    }
+}
+
+/* The kernels already write the displayed coordinates into the mapped
+pixel unpack buffer while they finish each tile, so usually all that is
+left is to queue its upload. Only when nothing was staged since the last
+upload, like right after init_config or in the flip time mode, are they
+converted here. */
+template <typename S>
+void CPUIntegration::transfer_to_quad(State<S> &state, Quad &dst) {
+    // The adaptive method leaves every pendulum at its own local time, and
+    // only its interpolated coordinates are at the time being displayed.
+    const CoordArrays<S> &coords
+        = (this->integrator == INTEGRATOR_DOPRI5)?
+            state.dense_coords: state.coords;
+    if (coords.size == 0)
+        return;
+    if (!this->staged) {
+        float *display = this->upload.map();
+        if (display == NULL)
+            return;
+        const std::vector<uint32_t> &pixels = state.pixels;
+        this->pool->run(
+            this->chunk_count<S>(coords.size), [&](size_t chunk) {
+            size_t begin, end;
+            this->chunk_range<S>(coords.size, chunk, begin, end);
+            end = std::min(end, coords.size);
+            for (size_t i = begin; i < end; i++) {
+                size_t pixel = (pixels.empty())? i: pixels[i];
+                display[4*pixel] = coords.pi1[i];
+                display[4*pixel + 1] = coords.pi2[i];
+                display[4*pixel + 2] = coords.phi1[i];
+                display[4*pixel + 3] = coords.phi2[i];
+            }
+        });
+    }
+    this->upload.upload(dst);
+    this->staged = false;
+}
+
+void CPUIntegration::transfer_to_quad(Quad &dst) {
+    switch(this->precision) {
+        case CPU_FLOAT:
+        this->transfer_to_quad(this->f32, dst);
+        break;
+        case CPU_LONG_DOUBLE:
+        this->transfer_to_quad(this->f80, dst);
+        break;
+        default:
+        this->transfer_to_quad(this->f64, dst);
+        break;
+    }
+}
+
+void CPUIntegration::transfer_flip_times_to_quad(Quad &dst) {
+    if (!this->flip_mode || !this->flip_times_changed)
+        return;
+    float *data = this->flip_upload.map();
+    if (data == NULL)
+        return;
+    std::copy(this->flip_times.begin(), this->flip_times.end(), data);
+    this->flip_upload.upload(dst);
+    this->flip_times_changed = false;
+}
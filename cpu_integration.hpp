@@ -0,0 +1,207 @@
+#ifndef _CPU_INTEGRATION_
+#define _CPU_INTEGRATION_
+
+#include "gl_wrappers.hpp"
+#include "parameters.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
+
+
+struct DoublePendulumParams {
+    float mass1, mass2;
+    float length1, length2;
+    float gravity;
+};
+
+/* Scalar type used by the CPU integrator. Float doubles the number of
+pendulums per SIMD register and halves the memory traffic, which is enough
+for previews, while long double is only there for reference runs and is
+never vectorized. */
+enum CPUPrecision {
+    CPU_FLOAT=0, CPU_DOUBLE=1, CPU_LONG_DOUBLE=2
+};
+
+/* Structure-of-arrays storage for the coordinates of every pendulum
+in the grid. Each array is padded with zeroed pendulums up to a multiple of
+the widest SIMD register, so that kernels never need a scalar remainder loop.
+*/
+template <typename S>
+struct CoordArrays {
+    enum { PADDING=(64/sizeof(S) > 1)? 64/sizeof(S): 1 };
+    size_t size;
+    std::vector<S> pi1;
+    std::vector<S> pi2;
+    std::vector<S> phi1;
+    std::vector<S> phi2;
+    CoordArrays(): size(0) {}
+    void resize(size_t size);
+    size_t padded_size() const;
+    void swap(size_t i, size_t j);
+};
+
+/* Pointers into the four arrays of a CoordArrays. */
+template <typename S>
+struct CoordPointers {
+    S *pi1;
+    S *pi2;
+    S *phi1;
+    S *phi2;
+};
+
+/* Integration method, shared by both backends.
+ - RK4 takes fixed steps of dt.
+ - GAUSS_LEGENDRE is the two stage Gauss-Legendre method. It is implicit,
+   symplectic and of fourth order, and solves for its stages by fixed point
+   iteration.
+ - EXTENDED_PHASE_SPACE is Tao's explicit symplectic method for
+   non-separable Hamiltonians, composed to fourth order. It integrates two
+   bound copies of every pendulum over each step, which are then averaged,
+   so that it is only nearly symplectic.
+ - DOPRI5 is the Dormand-Prince 5(4) embedded pair, where every pendulum
+   keeps its own step size and local time, so that only the chaotic parts of
+   the grid pay for small steps. It is only available on the CPU, and the GPU
+   falls back to RK4.
+Unlike RK4, the two symplectic methods keep the energy from drifting over
+long runs, even with large time steps. */
+enum Integrator {
+    INTEGRATOR_RK4=0,
+    INTEGRATOR_GAUSS_LEGENDRE=1,
+    INTEGRATOR_EXTENDED_PHASE_SPACE=2,
+    INTEGRATOR_DOPRI5=3,
+    INTEGRATOR_COUNT
+};
+
+/* Strength of the binding between the two copies of each pendulum in the
+extended phase space method, omega in Tao's paper. As the copies are
+averaged after every step, it only needs to be strong enough to keep them
+together over a single step, and weaker bindings have smaller errors. */
+static const double EXTENDED_PHASE_SPACE_BINDING = 1.0;
+
+/* Everything a kernel needs to advance a range of pendulums. DOPRI5 also
+reads and writes the arrays after coords, which hold for each pendulum the
+coordinates interpolated to the end of the last call, the size of its next
+step, and how far its local time is from that of the display. Those are left
+null for the other methods. If display is not null, every method also writes
+the coordinates to be displayed after the call into it, as the interleaved
+floats of the first size pendulums. If flip_times is not null, the kernels
+record in it the time at which either arm of each pendulum first goes over
+the top, counting from time at the start of the call, and stop integrating
+a register's worth of pendulums once all of them have flipped. A flip time
+of zero means that the pendulum has not flipped yet. */
+template <typename S>
+struct KernelArgs {
+    CoordPointers<S> coords;
+    CoordPointers<S> dense_coords;
+    S *step_sizes;
+    S *time_offsets;
+    DoublePendulumParams params;
+    double dt;
+    int steps;
+    double tolerance;
+    float *display;
+    size_t size;
+    S *flip_times;
+    double time;
+};
+
+class CPUIntegration {
+    /* Coordinates and kernels for one scalar type. Only the state of
+    the precision currently in use holds any memory. There is one kernel
+    for each Integrator and DotsPreset, with the constants of that parameter
+    set folded in, and the one matching the current parameters is picked on
+    every time step.
+    In the flip time mode, the pendulums that are yet to flip are kept in
+    the first active slots of the arrays, which are the only ones that are
+    integrated, and pixels gives the pixel of the pendulum in each slot. */
+    template <typename S>
+    struct State {
+        typedef void (*Kernel)(
+            const KernelArgs<S> &args, size_t begin, size_t end);
+        std::vector<Kernel> kernels;
+        CoordArrays<S> coords;
+        CoordArrays<S> dense_coords;
+        std::vector<S> step_sizes;
+        std::vector<S> time_offsets;
+        std::vector<S> flip_times;
+        std::vector<uint32_t> pixels;
+        size_t active;
+        State(): active(0) {}
+        void swap(size_t i, size_t j);
+        template <Integrator M, typename K>
+        static Kernel widest_kernel(SIMDLevel level);
+        template <Integrator M>
+        void select_kernels(SIMDLevel level);
+        void select_kernels(SIMDLevel level);
+    };
+    SIMDLevel simd_level;
+    CPUPrecision precision;
+    Integrator integrator;
+    double tolerance;
+    // Sign of the last dt, as the local times of the adaptive method are
+    // measured in the direction of integration.
+    int direction;
+    State<float> f32;
+    State<double> f64;
+    State<long double> f80;
+    std::unique_ptr<ThreadPool> pool;
+    int requested_thread_count;
+    bool requested_pinning;
+    // Written by the kernels of every time step, and uploaded on the
+    // next transfer_to_quad.
+    PixelUnpackBuffers upload;
+    bool staged;
+    bool flip_mode;
+    // Time since init_config, and the flip time of every pixel, which is
+    // zero for those that have not flipped yet.
+    double time;
+    std::vector<float> flip_times;
+    bool flip_times_changed;
+    PixelUnpackBuffers flip_upload;
+    template <typename S>
+    size_t chunk_count(size_t size) const;
+    template <typename S>
+    void chunk_range(
+        size_t size, size_t chunk, size_t &begin, size_t &end) const;
+    template <typename S>
+    void retire_flipped(State<S> &state);
+    template <typename S>
+    void init_config(State<S> &state, sim_2d::SimParams params);
+    template <typename S>
+    void time_step(
+        State<S> &state, DoublePendulumParams params, double dt, int steps);
+    template <typename S>
+    void transfer_to_quad(State<S> &state, Quad &dst);
+    public:
+    CPUIntegration();
+    /* Also selects the precision given by params.cpuPrecision and the
+    method given by params.integrator, and frees the coordinates of any
+    other precision. In the flip time mode, the pendulums that do not have
+    the energy to ever flip are left out of the integration from the
+    start. */
+    void init_config(sim_2d::SimParams params);
+    /* Error tolerance of DOPRI5, both absolute and relative.
+    It is raised to a small multiple of the machine epsilon of the scalar
+    type if needed. */
+    void set_tolerance(double tolerance);
+    /* Number of threads used for integration (0 for every core), and
+    whether to pin them to cores. The pool is only rebuilt on changes. */
+    void set_threads(int thread_count, bool pin);
+    /* Advance every pendulum by steps*dt. The fixed step methods take
+    the given number of steps, where each register-sized tile of pendulums is
+    kept in registers over all of the steps, so batching steps avoids
+    streaming the grid through memory once per step. With DOPRI5 every
+    pendulum takes as many steps as its tolerance requires, and is then
+    interpolated to the common end time for display. */
+    void time_step(
+        DoublePendulumParams params, double dt, int steps=1);
+    /* Queue the upload of the coordinates to dst. This does not wait for
+    the upload to finish, and costs next to nothing after a time step, whose
+    kernels already write out the coordinates in the layout of dst. */
+    void transfer_to_quad(Quad &dst);
+    /* Upload the flip times in the flip time mode, if any have changed
+    since the last upload. */
+    void transfer_flip_times_to_quad(Quad &dst);
+
+};
+
+#endif
@@ -0,0 +1,146 @@
+/* Generated by make_dots_kernels.py. Do not edit.
+
+Time derivatives of the double pendulum coordinates. These are the
+Hamiltonian equations of motion of symbolic.ipynb, with common subexpressions
+eliminated, and with the factors that only depend on the pendulum parameters
+collected in DotsConstants so that they are computed once per kernel call.
+*/
+#include "simd.hpp"
+#include "cpu_integration.hpp"
+
+#ifndef _DOUBLE_PENDULUM_DOTS_
+#define _DOUBLE_PENDULUM_DOTS_
+
+/* S is the scalar type of the integrator. */
+template <typename S>
+struct DotsConstants {
+    typedef S scalar;
+    S k0, k1, k2, k3, k4, k5, k6, k7, k8, k9;
+    DotsConstants(DoublePendulumParams params) {
+        S mass1 = params.mass1;
+        S mass2 = params.mass2;
+        S length1 = params.length1;
+        S length2 = params.length2;
+        S gravity = params.gravity;
+        k0 = length1*length2*mass2;
+        k1 = -mass1 - mass2;
+        k2 = -1.0/length1;
+        k3 = -(mass1 + mass2)/(length2*mass2);
+        k4 = -length1*length1*length2*length2*mass2*mass2;
+        k5 = -length1*length2*mass2*(mass1 + mass2)*(length1 + length2 - 3.0);
+        k6 = length1*length1*length2*mass2*(length1 - 1.0)*(mass1 + mass2);
+        k7 = length1*length2*length2*mass2*mass2*(length2 - 1.0);
+        k8 = -gravity*length1*(mass1 + mass2);
+        k9 = -gravity*length2*mass2;
+    }
+};
+
+/* T is either a scalar type or one of the SIMD vector types. */
+template <typename T>
+SIMD_INLINE void double_pendulum_dots(
+    T &dot_pi1, T &dot_pi2, T &dot_phi1, T &dot_phi2,
+    const T &pi1, const T &pi2, const T &phi1, const T &phi2,
+    const DotsConstants<typename SIMDTraits<T>::scalar> &k) {
+    typedef typename SIMDTraits<T>::scalar S;
+    T sin1, cos1, sin2, cos2;
+    simd_sincos(phi1, sin1, cos1);
+    simd_sincos(phi2, sin2, cos2);
+    T s = sin1*cos2 - cos1*sin2;
+    T c = cos1*cos2 + sin1*sin2;
+    T inv_d = S(1.0)/(c*c*k.k0 + k.k1);
+    dot_phi1 = inv_d*(c*pi2 + k.k2*pi1);
+    dot_phi2 = inv_d*(c*pi1 + k.k3*pi2);
+    T dh_dc = inv_d*(c*dot_phi1*dot_phi1*k.k6 + c*dot_phi2*dot_phi2*k.k7 + dot_phi1*dot_phi2*(c*c*k.k4 + k.k5));
+    dot_pi1 = dh_dc*s + k.k8*sin1;
+    dot_pi2 = -dh_dc*s + k.k9*sin2;
+}
+
+/* S is the scalar type of the integrator. */
+template <typename S>
+struct UnitDotsConstants {
+    typedef S scalar;
+    S k0, k1;
+    UnitDotsConstants(DoublePendulumParams params) {
+        S gravity = params.gravity;
+        k0 = -2.0*gravity;
+        k1 = -gravity;
+    }
+};
+
+/* T is either a scalar type or one of the SIMD vector types. */
+template <typename T>
+SIMD_INLINE void double_pendulum_dots(
+    T &dot_pi1, T &dot_pi2, T &dot_phi1, T &dot_phi2,
+    const T &pi1, const T &pi2, const T &phi1, const T &phi2,
+    const UnitDotsConstants<typename SIMDTraits<T>::scalar> &k) {
+    typedef typename SIMDTraits<T>::scalar S;
+    T sin1, cos1, sin2, cos2;
+    simd_sincos(phi1, sin1, cos1);
+    simd_sincos(phi2, sin2, cos2);
+    T s = sin1*cos2 - cos1*sin2;
+    T c = cos1*cos2 + sin1*sin2;
+    T inv_d = S(1.0)/(c*c + S(-2.0));
+    dot_phi1 = inv_d*(c*pi2 - pi1);
+    dot_phi2 = inv_d*(c*pi1 - S(2.0)*pi2);
+    T dh_dc = dot_phi1*dot_phi2*inv_d*(S(2.0) - c*c);
+    dot_pi1 = dh_dc*s + k.k0*sin1;
+    dot_pi2 = -dh_dc*s + k.k1*sin2;
+}
+
+/* S is the scalar type of the integrator. */
+template <typename S>
+struct UnitLengthDotsConstants {
+    typedef S scalar;
+    S k0, k1, k2, k3, k4, k5, k6;
+    UnitLengthDotsConstants(DoublePendulumParams params) {
+        S mass1 = params.mass1;
+        S mass2 = params.mass2;
+        S gravity = params.gravity;
+        k0 = mass2;
+        k1 = -mass1 - mass2;
+        k2 = -(mass1 + mass2)/mass2;
+        k3 = -mass2*mass2;
+        k4 = mass2*(mass1 + mass2);
+        k5 = -gravity*(mass1 + mass2);
+        k6 = -gravity*mass2;
+    }
+};
+
+/* T is either a scalar type or one of the SIMD vector types. */
+template <typename T>
+SIMD_INLINE void double_pendulum_dots(
+    T &dot_pi1, T &dot_pi2, T &dot_phi1, T &dot_phi2,
+    const T &pi1, const T &pi2, const T &phi1, const T &phi2,
+    const UnitLengthDotsConstants<typename SIMDTraits<T>::scalar> &k) {
+    typedef typename SIMDTraits<T>::scalar S;
+    T sin1, cos1, sin2, cos2;
+    simd_sincos(phi1, sin1, cos1);
+    simd_sincos(phi2, sin2, cos2);
+    T s = sin1*cos2 - cos1*sin2;
+    T c = cos1*cos2 + sin1*sin2;
+    T inv_d = S(1.0)/(c*c*k.k0 + k.k1);
+    dot_phi1 = inv_d*(c*pi2 - pi1);
+    dot_phi2 = inv_d*(c*pi1 + k.k2*pi2);
+    T dh_dc = dot_phi1*dot_phi2*inv_d*(c*c*k.k3 + k.k4);
+    dot_pi1 = dh_dc*s + k.k5*sin1;
+    dot_pi2 = -dh_dc*s + k.k6*sin2;
+}
+
+/* Parameter sets with their own specialized kernel. */
+enum DotsPreset {
+    DOTS_GENERIC=0, DOTS_UNIT, DOTS_UNIT_LENGTH, DOTS_PRESET_COUNT
+};
+
+inline DotsPreset dots_preset(DoublePendulumParams params) {
+    if (params.mass1 == 1.0F
+        && params.mass2 == 1.0F
+        && params.length1 == 1.0F
+        && params.length2 == 1.0F)
+        return DOTS_UNIT;
+    if (params.length1 == 1.0F
+        && params.length2 == 1.0F)
+        return DOTS_UNIT_LENGTH;
+    return DOTS_GENERIC;
+}
+
+#endif
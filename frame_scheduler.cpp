@@ -0,0 +1,81 @@
+#include "frame_scheduler.hpp"
+#include <algorithm>
+
+// Seconds of steps between the frames of the UNCAPPED mode.
+static const double UNCAPPED_FRAME_TIME = 0.1;
+// Weight of the newest time in the smoothed times.
+static const double SMOOTHING = 0.2;
+static const int MAX_STEPS_PER_FRAME = 1 << 20;
+
+FrameScheduler::FrameScheduler():
+    m_step_time(0.0), m_draw_time(0.0), m_steps(0),
+    m_step_timer(), m_draw_timer(), m_timed_steps(), m_draw_cpu_times(),
+    m_start(), m_steps_end() {}
+
+bool FrameScheduler::is_timed(int mode) {
+    return (mode == FRAME_TIME || mode == UNCAPPED)
+        && gpu_timer_queries_supported();
+}
+
+int FrameScheduler::steps(int mode, int fixed_steps, double frame_time) {
+    if (!is_timed(mode)) {
+        m_steps = fixed_steps;
+        return m_steps;
+    }
+    this->collect_times();
+    if (m_step_time <= 0.0) {
+        m_steps = 1;
+        return m_steps;
+    }
+    double budget = ((mode == UNCAPPED)? UNCAPPED_FRAME_TIME: frame_time)
+        - m_draw_time;
+    double steps = std::min(budget/m_step_time, double(MAX_STEPS_PER_FRAME));
+    // The steps at most double from one frame to the next, so that a
+    // misleadingly fast frame cannot stall the ones after it.
+    m_steps = std::max(1, std::min(int(steps), 2*std::max(m_steps, 1)));
+    return m_steps;
+}
+
+static double smooth(double average, double value) {
+    return (average <= 0.0)? value: average + SMOOTHING*(value - average);
+}
+
+/* Take in the times of the frames that the GPU has finished since the
+last call, skipping those that were lost. */
+void FrameScheduler::collect_times() {
+    double seconds = 0.0;
+    while (m_step_timer.poll(seconds)) {
+        int steps = m_timed_steps.front().first;
+        double cpu_seconds = m_timed_steps.front().second;
+        m_timed_steps.pop_front();
+        if (seconds >= 0.0 && steps > 0)
+            m_step_time = smooth(
+                m_step_time, std::max(seconds, cpu_seconds)/steps);
+    }
+    while (m_draw_timer.poll(seconds)) {
+        double cpu_seconds = m_draw_cpu_times.front();
+        m_draw_cpu_times.pop_front();
+        if (seconds >= 0.0)
+            m_draw_time = smooth(m_draw_time, std::max(seconds, cpu_seconds));
+    }
+}
+
+void FrameScheduler::start_steps() {
+    m_step_timer.begin();
+    m_start = Clock::now();
+}
+
+void FrameScheduler::end_steps() {
+    m_step_timer.end();
+    m_steps_end = Clock::now();
+    m_timed_steps.push_back(
+        {m_steps,
+         std::chrono::duration<double>(m_steps_end - m_start).count()});
+    m_draw_timer.begin();
+}
+
+void FrameScheduler::end_draw() {
+    m_draw_timer.end();
+    m_draw_cpu_times.push_back(
+        std::chrono::duration<double>(Clock::now() - m_steps_end).count());
+}
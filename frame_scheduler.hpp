@@ -0,0 +1,56 @@
+/* Picks how many time steps to take before each presented frame, so that
+the view is drawn exactly once per frame and the number of steps follows
+how fast the machine actually is:
+ - FIXED takes the given number of steps on every frame,
+ - FRAME_TIME fits the steps into a target frame time, together with drawing
+   the view, from how long the steps and the drawing of the last frames took,
+ - UNCAPPED steps for as long as possible and only presents a few frames a
+   second, for the most steps per second.
+The steps and the drawing are timed on the GPU with GPUTimer, whose times
+arrive a few frames late, so that the CPU never waits for the GPU, and also
+on the CPU, for the CPU backend, whose steps take next to no GPU time. The
+larger of the two is taken. The times are smoothed over several frames,
+so that a single slow frame does not make the number of steps jump around.
+Where the GPU cannot be timed, the timed modes fall back to FIXED.
+*/
+#include "gl_wrappers.hpp"
+#include <chrono>
+#include <deque>
+
+#ifndef _FRAME_SCHEDULER_
+#define _FRAME_SCHEDULER_
+
+class FrameScheduler {
+    public:
+    enum Mode {FIXED=0, FRAME_TIME=1, UNCAPPED=2};
+    private:
+    typedef std::chrono::steady_clock Clock;
+    // Smoothed seconds per step, and per draw of the view.
+    double m_step_time;
+    double m_draw_time;
+    int m_steps;
+    GPUTimer m_step_timer;
+    GPUTimer m_draw_timer;
+    // Steps and CPU seconds of each interval of m_step_timer, and CPU
+    // seconds of each of m_draw_timer, not yet collected.
+    std::deque<std::pair<int, double>> m_timed_steps;
+    std::deque<double> m_draw_cpu_times;
+    Clock::time_point m_start;
+    Clock::time_point m_steps_end;
+    void collect_times();
+    public:
+    FrameScheduler();
+    /* Whether the mode times the steps and drawing of each frame, which
+    is false for every mode if the GPU cannot be timed. */
+    static bool is_timed(int mode);
+    /* Steps to take before the next frame, where frame_time is the target
+    in seconds and fixed_steps the steps for the FIXED mode. */
+    int steps(int mode, int fixed_steps, double frame_time);
+    /* Call before the steps of a frame, between the steps and the drawing
+    of the view, and after the drawing. */
+    void start_steps();
+    void end_steps();
+    void end_draw();
+};
+
+#endif
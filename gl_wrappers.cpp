@@ -16,10 +16,16 @@ introduction to OpenGL without any prior graphics knowledge.
 #include "gl_wrappers.hpp"
 
 #include <stdio.h>
+#include <string.h>
 #include <GLES3/gl3.h>
 #include <GLES3/gl32.h>
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#ifndef __EMSCRIPTEN__
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 size_t s_frames_count = 0;
 
@@ -34,6 +40,226 @@ static size_t acquire_new_frame() {
     return frame_id;
 }
 
+/* A copy of the GL state that the wrappers change on every draw, so that
+changes to what is already set are skipped, and the state never needs to be
+read back with glGet, which stalls on many drivers and always in WebGL. Every
+change to this state has to go through the functions below. NO_NAME marks
+state that is not known, such as the element array buffer after a vertex
+array is bound, as that binding belongs to the vertex array. */
+static const uint32_t NO_NAME = 0xFFFFFFFF;
+
+static struct {
+    int viewport[4];
+    uint32_t program;
+    uint32_t framebuffer;
+    uint32_t renderbuffer;
+    uint32_t vertex_array;
+    uint32_t array_buffer;
+    uint32_t element_array_buffer;
+    GLStateChangeCounts counts;
+} s_gl_state = {
+    .viewport={-1, -1, -1, -1},
+    .program=NO_NAME, .framebuffer=NO_NAME, .renderbuffer=NO_NAME,
+    .vertex_array=NO_NAME, .array_buffer=NO_NAME,
+    .element_array_buffer=NO_NAME,
+    .counts={.made=0, .avoided=0}
+};
+
+static bool record_state_change(bool changed) {
+    if (changed)
+        s_gl_state.counts.made++;
+    else
+        s_gl_state.counts.avoided++;
+    return changed;
+}
+
+static void set_viewport(int x, int y, int width, int height) {
+    int *viewport = s_gl_state.viewport;
+    if (record_state_change(viewport[0] != x || viewport[1] != y
+                            || viewport[2] != width
+                            || viewport[3] != height)) {
+        glViewport(x, y, width, height);
+        viewport[0] = x;
+        viewport[1] = y;
+        viewport[2] = width;
+        viewport[3] = height;
+    }
+}
+
+static void use_program(uint32_t program) {
+    if (record_state_change(s_gl_state.program != program)) {
+        glUseProgram(program);
+        s_gl_state.program = program;
+    }
+}
+
+static void bind_framebuffer(uint32_t framebuffer) {
+    if (record_state_change(s_gl_state.framebuffer != framebuffer)) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        s_gl_state.framebuffer = framebuffer;
+    }
+}
+
+static void bind_renderbuffer(uint32_t renderbuffer) {
+    if (record_state_change(s_gl_state.renderbuffer != renderbuffer)) {
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+        s_gl_state.renderbuffer = renderbuffer;
+    }
+}
+
+static void bind_vertex_array(uint32_t vertex_array) {
+    if (record_state_change(s_gl_state.vertex_array != vertex_array)) {
+        glBindVertexArray(vertex_array);
+        s_gl_state.vertex_array = vertex_array;
+        s_gl_state.element_array_buffer = NO_NAME;
+    }
+}
+
+static void bind_array_buffer(uint32_t buffer) {
+    if (record_state_change(s_gl_state.array_buffer != buffer)) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        s_gl_state.array_buffer = buffer;
+    }
+}
+
+static void bind_element_array_buffer(uint32_t buffer) {
+    if (record_state_change(s_gl_state.element_array_buffer != buffer)) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+        s_gl_state.element_array_buffer = buffer;
+    }
+}
+
+/* Deleting a bound object unbinds it, and its name may be given to a new
+object afterwards. */
+static void forget_framebuffer(uint32_t framebuffer) {
+    if (s_gl_state.framebuffer == framebuffer)
+        s_gl_state.framebuffer = NO_NAME;
+}
+
+static void forget_vertex_array(uint32_t vertex_array) {
+    if (s_gl_state.vertex_array == vertex_array) {
+        s_gl_state.vertex_array = NO_NAME;
+        s_gl_state.element_array_buffer = NO_NAME;
+    }
+}
+
+static void forget_buffer(uint32_t buffer) {
+    if (s_gl_state.array_buffer == buffer)
+        s_gl_state.array_buffer = NO_NAME;
+    if (s_gl_state.element_array_buffer == buffer)
+        s_gl_state.element_array_buffer = NO_NAME;
+}
+
+/* Texture units are handed out on every draw to the textures sampled by
+its program, rather than each texture keeping a unit of its own, so that the
+number of textures is not limited by the number of units. Textures stay
+bound to their units between draws, and when no unit is free the one used
+the longest ago is taken, so that the textures sampled on consecutive draws
+are not bound again. Unit 0 is never handed out, and is where textures are
+bound to be created or written to. */
+static struct {
+    std::vector<uint32_t> textures;
+    std::vector<uint64_t> last_used;
+    // Incremented on every draw, so that the units taken by one draw are
+    // not given away again within it.
+    uint64_t draw_count;
+    int active_unit;
+} s_texture_units = {
+    .textures={}, .last_used={}, .draw_count=0, .active_unit=-1
+};
+
+static void init_texture_units() {
+    if (!s_texture_units.textures.empty())
+        return;
+    GLint count = 0;
+    glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &count);
+    // The minimum of ES 3.0 is 32.
+    if (count < 2)
+        count = 32;
+    s_texture_units.textures.resize(count, 0);
+    s_texture_units.last_used.resize(count, 0);
+}
+
+static void set_active_texture_unit(int unit) {
+    if (!record_state_change(unit != s_texture_units.active_unit))
+        return;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    s_texture_units.active_unit = unit;
+}
+
+static void begin_texture_units_draw() {
+    s_texture_units.draw_count++;
+}
+
+/* Bind texture to a unit for sampling in the current draw, and return that
+unit. */
+static int bind_texture_unit(uint32_t texture) {
+    init_texture_units();
+    std::vector<uint32_t> &textures = s_texture_units.textures;
+    std::vector<uint64_t> &last_used = s_texture_units.last_used;
+    int least_recent = 1;
+    for (int unit = 1; unit < (int)textures.size(); unit++) {
+        if (textures[unit] == texture) {
+            record_state_change(false);
+            last_used[unit] = s_texture_units.draw_count;
+            return unit;
+        }
+        if (last_used[unit] < last_used[least_recent])
+            least_recent = unit;
+    }
+    if (last_used[least_recent] == s_texture_units.draw_count)
+        fprintf(stderr, "More textures are sampled in a single draw "
+                "than there are texture units.\n");
+    set_active_texture_unit(least_recent);
+    record_state_change(true);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    textures[least_recent] = texture;
+    last_used[least_recent] = s_texture_units.draw_count;
+    return least_recent;
+}
+
+/* Bind texture to unit 0, to create it or write to it. */
+static void bind_texture_for_update(uint32_t texture) {
+    init_texture_units();
+    set_active_texture_unit(0);
+    if (record_state_change(s_texture_units.textures[0] != texture)) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        s_texture_units.textures[0] = texture;
+    }
+}
+
+/* Must be called on deleting a texture, as GL reuses the names of deleted
+textures. */
+static void forget_texture(uint32_t texture) {
+    for (size_t unit = 0; unit < s_texture_units.textures.size(); unit++) {
+        if (s_texture_units.textures[unit] == texture) {
+            s_texture_units.textures[unit] = 0;
+            s_texture_units.last_used[unit] = 0;
+        }
+    }
+}
+
+void invalidate_gl_state_cache() {
+    for (int i = 0; i < 4; i++)
+        s_gl_state.viewport[i] = -1;
+    s_gl_state.program = NO_NAME;
+    s_gl_state.framebuffer = NO_NAME;
+    s_gl_state.renderbuffer = NO_NAME;
+    s_gl_state.vertex_array = NO_NAME;
+    s_gl_state.array_buffer = NO_NAME;
+    s_gl_state.element_array_buffer = NO_NAME;
+    for (size_t unit = 0; unit < s_texture_units.textures.size(); unit++)
+        s_texture_units.textures[unit] = NO_NAME;
+    s_texture_units.active_unit = -1;
+}
+
+GLStateChangeCounts take_gl_state_change_counts() {
+    GLStateChangeCounts counts = s_gl_state.counts;
+    s_gl_state.counts.made = 0;
+    s_gl_state.counts.avoided = 0;
+    return counts;
+}
+
 static const char QUAD_VERTEX_SHADER[] = 
 R"(#if __VERSION__ <= 120
 attribute vec3 position;
@@ -82,7 +308,7 @@ static GLuint to_base(int sized) {
         return GL_RGBA;
     case GL_RGB32F: case GL_RGB32I: case GL_RGB32UI: case GL_RGB16F:
     case GL_RGB16I: case GL_RGB16UI: case GL_RGB8I: case GL_RGB8UI:
-    case GL_RGB8:
+    case GL_RGB8: case GL_R11F_G11F_B10F:
         return GL_RGB;
     case GL_RG32F: case GL_RG32I: case GL_RG32UI: case GL_RG16F:
     case GL_RG16I: case GL_RG16UI: case GL_RG8I: case GL_RG8UI:
@@ -102,7 +328,7 @@ static int number_of_channels(int sized) {
             return 4;
         case GL_RGB32F: case GL_RGB32I: case GL_RGB32UI: case GL_RGB16F:
         case GL_RGB16I: case GL_RGB16UI: case GL_RGB8I: case GL_RGB8UI:
-        case GL_RGB8:
+        case GL_RGB8: case GL_R11F_G11F_B10F:
             return 3;
         case GL_RG32F: case GL_RG32I: case GL_RG32UI: case GL_RG16F:
         case GL_RG16I: case GL_RG16UI: case GL_RG8I: case GL_RG8UI:
@@ -117,6 +343,7 @@ static int number_of_channels(int sized) {
 static GLuint to_type(int sized) {
     switch(sized) {
     case GL_RGBA32F: case GL_RGB32F: case GL_RG32F: case GL_R32F:
+    case GL_R11F_G11F_B10F:
         return GL_FLOAT;
     case GL_RGBA32I: case GL_RGB32I: case GL_RG32I: case GL_R32I:
         return GL_INT;
@@ -876,39 +1103,250 @@ void shader_from_source(
     }
 }
 
+static std::map<std::string, const char *> s_embedded_files;
+static std::string s_file_override_directory = "";
+
+void set_embedded_files(const std::map<std::string, const char *> &files) {
+    s_embedded_files = files;
+}
+
+void set_file_override_directory(const std::string &directory) {
+    s_file_override_directory = directory;
+}
+
+/* Read from the override directory first, then from the embedded files,
+and only then from the path itself. */
 static std::string get_file_contents(const std::string &fname) {
-    std::string s = std::string ();
-    std::filebuf fb;
-    if (!fb.open(fname, std::ios::in)) {
-        std::cout << "Opening " << fname << " failed." << std::endl;
-        fb.close();
-    }
-    for (; fb.sgetc() > 0; fb.snextc())
-        s.push_back(fb.sgetc());
+    std::string path = fname;
+    std::string relative_path
+        = (fname.compare(0, 2, "./") == 0)? fname.substr(2): fname;
+    std::map<std::string, const char *>::iterator embedded
+        = s_embedded_files.find(fname);
+    if (!s_file_override_directory.empty()
+        && std::ifstream(
+            s_file_override_directory + "/" + relative_path).good())
+        path = s_file_override_directory + "/" + relative_path;
+    else if (embedded != s_embedded_files.end())
+        return std::string(embedded->second) + '\0';
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file)
+        std::cout << "Opening " << path << " failed." << std::endl;
+    std::string s((std::istreambuf_iterator<char>(file)),
+                  std::istreambuf_iterator<char>());
     s.push_back('\0');
-    fb.close();
     return s;
 }
 
-uint32_t make_program_from_sources(
-    std::string vertex_src, std::string fragment_src) {
-    uint32_t vs_ref = shader_from_source(vertex_src, GL_VERTEX_SHADER);
-    uint32_t fs_ref = shader_from_source(fragment_src, GL_FRAGMENT_SHADER);
+static std::string s_program_binary_directory = "";
+
+void set_program_binary_cache(const std::string &directory) {
+    s_program_binary_directory = directory;
+    #ifndef __EMSCRIPTEN__
+    // Also creates the directories above it, such as ~/.cache.
+    for (size_t end = directory.find('/', 1); !directory.empty();
+         end = directory.find('/', end + 1)) {
+        mkdir(directory.substr(0, end).c_str(), 0755);
+        if (end == std::string::npos)
+            break;
+    }
+    #endif
+}
+
+static bool program_binaries_supported() {
+    #ifdef __EMSCRIPTEN__
+    return false;
+    #else
+    if (s_program_binary_directory.empty())
+        return false;
+    GLint format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    return format_count > 0;
+    #endif
+}
+
+// 64 bit FNV-1a.
+static uint64_t hash_bytes(uint64_t hash, const char *bytes, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (uint8_t)bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* Binaries are only valid for the driver that made them, so the driver and
+renderer are part of the name, along with the sources. */
+static std::string program_binary_path(const std::string &sources) {
+    uint64_t hash = hash_bytes(
+        14695981039346656037ULL, sources.c_str(), sources.size());
+    GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (GLenum name: names) {
+        const char *value = (const char *)glGetString(name);
+        if (value != NULL)
+            hash = hash_bytes(hash, value, strlen(value) + 1);
+    }
+    char file_name[32];
+    snprintf(file_name, sizeof(file_name), "%016llx.bin",
+             (unsigned long long)hash);
+    return s_program_binary_directory + "/" + file_name;
+}
+
+/* Returns 0 if there is no binary at the path, or if the driver rejects
+it, as it may after an update. */
+static uint32_t load_program_binary(const std::string &path) {
+    #ifdef __EMSCRIPTEN__
+    return 0;
+    #else
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    GLenum format = 0;
+    if (!file.read((char *)&format, sizeof(format)))
+        return 0;
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+    if (binary.empty())
+        return 0;
+    uint32_t program = glCreateProgram();
+    glProgramBinary(program, format, &binary[0], binary.size());
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        fprintf(stdout, "Program binary \"%s\" was rejected.\n",
+                path.c_str());
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+    #endif
+}
+
+static void save_program_binary(uint32_t program, const std::string &path) {
+    #ifndef __EMSCRIPTEN__
+    GLint status, length = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (status != GL_TRUE || length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, &binary[0]);
+    if (length <= 0)
+        return;
+    // Written to a file of its own and then renamed into place, so that
+    // other launches never load a partly written binary.
+    std::string temporary_path
+        = path + "." + std::to_string(getpid()) + ".tmp";
+    std::ofstream file(temporary_path, std::ios::out | std::ios::binary);
+    file.write((const char *)&format, sizeof(format));
+    file.write(&binary[0], length);
+    file.close();
+    if (!file || rename(temporary_path.c_str(), path.c_str()) != 0) {
+        fprintf(stderr, "Unable to write program binary \"%s\".\n",
+                path.c_str());
+        remove(temporary_path.c_str());
+    }
+    #endif
+}
+
+struct ShaderStage {
+    GLenum type;
+    std::string source;
+};
+
+/* The source, with the version line for the current context. */
+static std::string with_version(const std::string &source, GLenum type) {
+    #ifdef __EMSCRIPTEN__
+    return "#version 300 es\n" + source;
+    #else
+    if (type == GL_COMPUTE_SHADER) {
+        const char *version = (const char *)glGetString(GL_VERSION);
+        bool is_es = version != NULL
+            && std::string(version).find("OpenGL ES") == 0;
+        return ((is_es)? "#version 310 es\n": "#version 430\n") + source;
+    }
+    return "#version 330\n" + source;
+    #endif
+}
+
+/* Issue the compiling and linking of a program, without checking on
+either, which would wait for them to finish. If the program is in the
+program binary cache it is loaded from there instead, and otherwise
+cache_path is set to where finish_program should add it. */
+static uint32_t begin_program(
+    const std::vector<ShaderStage> &stages, std::string &cache_path) {
+    std::vector<std::string> sources;
+    std::string key;
+    for (const ShaderStage &stage: stages) {
+        sources.push_back(with_version(stage.source, stage.type));
+        key += sources.back() + '\0';
+    }
+    cache_path = "";
+    if (program_binaries_supported()) {
+        std::string path = program_binary_path(key);
+        uint32_t program = load_program_binary(path);
+        if (program != 0)
+            return program;
+        cache_path = path;
+    }
     uint32_t program = glCreateProgram();
     if (program == 0) {
         fprintf(stderr, "Unable to create program.\n");
     }
-    glAttachShader(program, vs_ref);
-    glAttachShader(program, fs_ref);
+    for (size_t i = 0; i < stages.size(); i++) {
+        uint32_t shader = glCreateShader(stages[i].type);
+        const char *source = sources[i].c_str();
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        glAttachShader(program, shader);
+        // Only freed once it is detached, after linking.
+        glDeleteShader(shader);
+    }
+    // Otherwise the driver need not keep a binary that it can give back.
+    #ifndef __EMSCRIPTEN__
+    if (!cache_path.empty())
+        glProgramParameteri(
+            program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    #endif
     glLinkProgram(program);
+    return program;
+}
+
+/* Wait for a program from begin_program to link, report any errors in
+compiling or linking it, and add it to the program binary cache.
+Returns whether it linked. */
+static bool finish_program(uint32_t program, const std::string &cache_path) {
     GLint status;
     char buf[1024] = {'\0',};
+    GLuint shaders[4];
+    GLsizei shader_count = 0;
     glGetProgramiv(program, GL_LINK_STATUS, &status);
-    glGetProgramInfoLog(program, 1023, NULL, buf);
+    glGetAttachedShaders(program, 4, &shader_count, shaders);
     if (status != GL_TRUE) {
+        for (GLsizei i = 0; i < shader_count; i++) {
+            GLint compiled;
+            glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+            if (compiled == GL_TRUE)
+                continue;
+            glGetShaderInfoLog(shaders[i], 1023, NULL, buf);
+            fprintf(stderr, "%s\n%s\n", "Shader compilation failed:", buf);
+        }
+        glGetProgramInfoLog(program, 1023, NULL, buf);
         fprintf(stderr, "%s\n%s\n", "Failed to link program:", buf);
+        return false;
     }
-    glUseProgram(program);
+    for (GLsizei i = 0; i < shader_count; i++)
+        glDetachShader(program, shaders[i]);
+    if (!cache_path.empty())
+        save_program_binary(program, cache_path);
+    return true;
+}
+
+uint32_t make_program_from_sources(
+    std::string vertex_src, std::string fragment_src) {
+    std::string cache_path;
+    uint32_t program = begin_program(
+        {{.type=GL_VERTEX_SHADER, .source=vertex_src},
+         {.type=GL_FRAGMENT_SHADER, .source=fragment_src}}, cache_path);
+    finish_program(program, cache_path);
+    use_program(program);
     return program;
 }
 
@@ -921,6 +1359,316 @@ uint32_t make_program_from_paths(
     return make_program_from_sources(vertex_src, fragment_src);
 }
 
+static bool has_extension(const char *extension) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (name != NULL && strcmp(name, extension) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool parallel_shader_compile_supported() {
+    static int s_supported = -1;
+    if (s_supported < 0)
+        s_supported = has_extension("GL_KHR_parallel_shader_compile")
+            || has_extension("GL_ARB_parallel_shader_compile");
+    return s_supported;
+}
+
+bool compute_shaders_supported() {
+    #ifdef __EMSCRIPTEN__
+    return false;
+    #else
+    int major_version = 0, minor_version = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major_version);
+    glGetIntegerv(GL_MINOR_VERSION, &minor_version);
+    const char *version = (const char *)glGetString(GL_VERSION);
+    bool is_es = version != NULL
+        && std::string(version).find("OpenGL ES") == 0;
+    int required_minor_version = (is_es)? 1: 3;
+    int required_major_version = (is_es)? 3: 4;
+    return major_version > required_major_version
+        || (major_version == required_major_version
+            && minor_version >= required_minor_version);
+    #endif
+}
+
+bool is_color_renderable(uint32_t format) {
+    static std::map<uint32_t, bool> s_renderable;
+    std::map<uint32_t, bool>::iterator found = s_renderable.find(format);
+    if (found != s_renderable.end())
+        return found->second;
+    uint32_t texture, fbo;
+    glGenTextures(1, &texture);
+    bind_texture_for_update(texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, 1, 1, 0,
+                 to_base(format), to_type(format), NULL);
+    glGenFramebuffers(1, &fbo);
+    bind_framebuffer(fbo);
+    glFramebufferTexture2D(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    bool renderable = glCheckFramebufferStatus(GL_FRAMEBUFFER)
+        == GL_FRAMEBUFFER_COMPLETE;
+    forget_framebuffer(fbo);
+    glDeleteFramebuffers(1, &fbo);
+    forget_texture(texture);
+    glDeleteTextures(1, &texture);
+    // Formats that the context does not know fail in glTexImage2D.
+    while (glGetError() != GL_NO_ERROR);
+    s_renderable[format] = renderable;
+    return renderable;
+}
+
+uint32_t make_compute_program_from_source(std::string source) {
+    #ifdef __EMSCRIPTEN__
+    return 0;
+    #else
+    if (!compute_shaders_supported())
+        return 0;
+    std::string cache_path;
+    uint32_t program = begin_program(
+        {{.type=GL_COMPUTE_SHADER, .source=source}}, cache_path);
+    if (!finish_program(program, cache_path)) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+    #endif
+}
+
+uint32_t make_compute_program_from_path(std::string path) {
+    fprintf(stdout, "Creating compute program from \"%s\".\n",
+            path.c_str());
+    // get_file_contents leaves a null character at the end, which is
+    // not valid GLSL once it ends up before the end of the string.
+    std::string source = get_file_contents(path);
+    if (!source.empty() && source.back() == '\0')
+        source.pop_back();
+    return make_compute_program_from_source(source);
+}
+
+Program::Program(): id(0) {}
+
+Program::Program(uint32_t id): id(id) {
+    if (id == 0)
+        return;
+    GLint count = 0, max_length = 0;
+    glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    std::vector<char> name(max_length + 1);
+    for (int i = 0; i < count; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(id, i, name.size(), NULL, &size, &type, &name[0]);
+        // Members of uniform blocks have no location.
+        GLint location = glGetUniformLocation(id, &name[0]);
+        if (location < 0)
+            continue;
+        std::string uniform_name = &name[0];
+        this->uniform_locations[uniform_name] = location;
+        // Arrays are listed by their first element, but set by name.
+        size_t bracket = uniform_name.find("[0]");
+        if (bracket != std::string::npos)
+            this->uniform_locations[uniform_name.substr(0, bracket)]
+                = location;
+    }
+    glGetProgramiv(id, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+    name.resize(max_length + 1);
+    for (int i = 0; i < count; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(id, i, name.size(), NULL, &size, &type, &name[0]);
+        this->attribute_locations[&name[0]]
+            = glGetAttribLocation(id, &name[0]);
+    }
+}
+
+uint32_t Program::get_id() const {
+    return this->id;
+}
+
+Program::operator uint32_t() const {
+    return this->id;
+}
+
+int Program::uniform_location(const std::string &name) const {
+    auto location = this->uniform_locations.find(name);
+    return (location != this->uniform_locations.end())?
+        location->second: -1;
+}
+
+int Program::attribute_location(const std::string &name) const {
+    auto location = this->attribute_locations.find(name);
+    return (location != this->attribute_locations.end())?
+        location->second: -1;
+}
+
+void Program::bind_uniform_block(
+    const std::string &name, uint32_t binding) const {
+    if (this->id == 0)
+        return;
+    GLuint index = glGetUniformBlockIndex(this->id, name.c_str());
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(this->id, index, binding);
+}
+
+// From KHR_parallel_shader_compile, which has the same value as in the
+// ARB extension.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+LazyProgram::LazyProgram(): state(new State()) {
+    this->state->pending = 0;
+    this->state->made = false;
+}
+
+LazyProgram LazyProgram::quad(std::string fragment_path) {
+    LazyProgram lazy_program {};
+    lazy_program.state->fragment_path = fragment_path;
+    return lazy_program;
+}
+
+LazyProgram LazyProgram::from_paths(
+    std::string vertex_path, std::string fragment_path) {
+    LazyProgram lazy_program {};
+    lazy_program.state->vertex_path = vertex_path;
+    lazy_program.state->fragment_path = fragment_path;
+    return lazy_program;
+}
+
+LazyProgram LazyProgram::compute(std::string path) {
+    LazyProgram lazy_program {};
+    lazy_program.state->compute_path = path;
+    return lazy_program;
+}
+
+LazyProgram LazyProgram::with_defines(const std::string &defines) const {
+    LazyProgram lazy_program {};
+    State &state = *lazy_program.state;
+    state.vertex_path = this->state->vertex_path;
+    state.fragment_path = this->state->fragment_path;
+    state.compute_path = this->state->compute_path;
+    state.defines = defines;
+    state.uniform_blocks = this->state->uniform_blocks;
+    return lazy_program;
+}
+
+void LazyProgram::begin() const {
+    State &state = *this->state;
+    if (state.made || state.pending != 0)
+        return;
+    if (!state.compute_path.empty()) {
+        if (!compute_shaders_supported())
+            return;
+        fprintf(stdout, "Creating compute program from \"%s\".\n",
+                state.compute_path.c_str());
+        state.pending = begin_program(
+            {{.type=GL_COMPUTE_SHADER,
+              .source=state.defines + get_file_contents(state.compute_path)}},
+            state.cache_path);
+    } else if (state.vertex_path.empty()) {
+        fprintf(stdout, "Creating Quad program from \"%s\".\n",
+                state.fragment_path.c_str());
+        state.pending = begin_program(
+            {{.type=GL_VERTEX_SHADER,
+              .source=state.defines + QUAD_VERTEX_SHADER},
+             {.type=GL_FRAGMENT_SHADER,
+              .source=state.defines + get_file_contents(state.fragment_path)}},
+            state.cache_path);
+    } else {
+        fprintf(stdout,
+                "Creating program from these shaders: \"%s\" and \"%s\".\n",
+                state.vertex_path.c_str(), state.fragment_path.c_str());
+        state.pending = begin_program(
+            {{.type=GL_VERTEX_SHADER,
+              .source=state.defines + get_file_contents(state.vertex_path)},
+             {.type=GL_FRAGMENT_SHADER,
+              .source=state.defines + get_file_contents(state.fragment_path)}},
+            state.cache_path);
+    }
+}
+
+void LazyProgram::start() const {
+    if (parallel_shader_compile_supported())
+        this->begin();
+}
+
+bool LazyProgram::is_ready() const {
+    const State &state = *this->state;
+    if (state.made)
+        return true;
+    if (!parallel_shader_compile_supported())
+        return false;
+    // Compute programs are never started where compute shaders are not
+    // supported, and are made as Program() at once.
+    if (state.pending == 0)
+        return !state.compute_path.empty() && !compute_shaders_supported();
+    GLint completed = GL_FALSE;
+    glGetProgramiv(state.pending, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+bool LazyProgram::is_made() const {
+    return this->state->made;
+}
+
+const Program &LazyProgram::get() const {
+    State &state = *this->state;
+    if (state.made)
+        return state.program;
+    this->begin();
+    if (state.pending != 0) {
+        if (finish_program(state.pending, state.cache_path))
+            state.program = Program(state.pending);
+        else
+            glDeleteProgram(state.pending);
+    }
+    for (auto &block: state.uniform_blocks)
+        state.program.bind_uniform_block(block.first, block.second);
+    state.pending = 0;
+    state.made = true;
+    return state.program;
+}
+
+LazyProgram::operator const Program &() const {
+    return this->get();
+}
+
+void LazyProgram::bind_uniform_block(
+    const std::string &name, uint32_t binding) {
+    this->state->uniform_blocks.push_back({name, binding});
+    if (this->state->made)
+        this->state->program.bind_uniform_block(name, binding);
+}
+
+UniformBuffer::UniformBuffer(): buffer(0), size(0) {}
+
+void UniformBuffer::set_data(const void *data, size_t size) {
+    if (this->buffer == 0)
+        glGenBuffers(1, &this->buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+    if (size != this->size)
+        glBufferData(GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW);
+    else
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    this->size = size;
+}
+
+void UniformBuffer::bind(uint32_t binding) const {
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, this->buffer);
+}
+
+UniformBuffer::~UniformBuffer() {
+    if (this->buffer != 0)
+        glDeleteBuffers(1, &this->buffer);
+}
+
 /* class RecycledRender {
     enum { RENDER_TARGET, QUAD };
     int render_type;
@@ -931,7 +1679,7 @@ uint32_t make_program_from_paths(
     TextureParams params;
 };*/
 
-static bool texture_params_equal(
+bool texture_params_equal(
     const TextureParams &a,
     const TextureParams &b) {
     return (
@@ -959,27 +1707,37 @@ WireFrame::WireFrame(
     this->elements = elements;
     this->draw_type = draw_type;
     glGenVertexArrays(1, &this->vao);
-    glBindVertexArray(this->vao);
+    bind_vertex_array(this->vao);
     glGenBuffers(1, &this->vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+    bind_array_buffer(this->vbo);
     glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(float),
                  &vertices[0], GL_STATIC_DRAW);
     if (elements.size()) {
         glGenBuffers(1, &this->ebo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->ebo);
+        bind_element_array_buffer(this->ebo);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size()*sizeof(int),
                     &elements[0], GL_STATIC_DRAW);
     }
 }
 
 void WireFrame::draw(uint32_t program) {
-    glBindVertexArray(this->vao);
-    glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->ebo);
+    this->draw(program, NULL);
+}
+
+void WireFrame::draw(const Program &program) {
+    this->draw(program, &program);
+}
+
+void WireFrame::draw(uint32_t program, const Program *cached) {
+    bind_vertex_array(this->vao);
+    bind_array_buffer(this->vbo);
+    bind_element_array_buffer(this->ebo);
     for (auto &name_attribute: this->attributes) {
-        std::string name = name_attribute.first;
+        const std::string &name = name_attribute.first;
         Attribute attribute = name_attribute.second;
-        GLint id = glGetAttribLocation(program, name.c_str());
+        GLint id = (cached != NULL)?
+            cached->attribute_location(name):
+            glGetAttribLocation(program, name.c_str());
         glEnableVertexAttribArray(id); 
         /* std::cout << "size: " << attribute.size << std::endl;
         std::cout << "type: " << attribute.type << std::endl;
@@ -1035,37 +1793,41 @@ WireFrame::WireFrame(const WireFrame &w) {
     this->elements = w.elements;
     this->draw_type = w.draw_type;
     glGenVertexArrays(1, &this->vao);
-    glBindVertexArray(this->vao);
+    bind_vertex_array(this->vao);
     glGenBuffers(1, &this->vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+    bind_array_buffer(this->vbo);
     glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(float),
                  &vertices[0], GL_STATIC_DRAW);
     if (elements.size()) {
         glGenBuffers(1, &this->ebo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->ebo);
+        bind_element_array_buffer(this->ebo);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size()*sizeof(int),
                     &elements[0], GL_STATIC_DRAW);
     }
 }
 
 WireFrame& WireFrame::operator=(const WireFrame &w) {
+    forget_vertex_array(this->vao);
+    forget_buffer(this->vbo);
     glDeleteVertexArrays(1, &this->vao);
     glDeleteBuffers(1, &this->vbo);
-    if (this->elements.size())
+    if (this->elements.size()) {
+        forget_buffer(this->ebo);
         glDeleteBuffers(1, &this->ebo);
+    }
     this->attributes = w.attributes;
     this->vertices = w.vertices;
     this->elements = w.elements;
     this->draw_type = w.draw_type;
     glGenVertexArrays(1, &this->vao);
-    glBindVertexArray(this->vao);
+    bind_vertex_array(this->vao);
     glGenBuffers(1, &this->vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+    bind_array_buffer(this->vbo);
     glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(float),
                  &vertices[0], GL_STATIC_DRAW);
     if (elements.size()) {
         glGenBuffers(1, &this->ebo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->ebo);
+        bind_element_array_buffer(this->ebo);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size()*sizeof(int),
                     &elements[0], GL_STATIC_DRAW);
     }
@@ -1073,6 +1835,9 @@ WireFrame& WireFrame::operator=(const WireFrame &w) {
 }
 
 WireFrame::~WireFrame() {
+    forget_vertex_array(this->vao);
+    forget_buffer(this->vbo);
+    forget_buffer(this->ebo);
     glDeleteVertexArrays(1, &this->vao);
     glDeleteBuffers(1, &this->vbo);
     glDeleteBuffers(1, &this->ebo);
@@ -1084,19 +1849,18 @@ WireFrame::~WireFrame() {
 }*/
 
 static void unbind() {
-    glBindVertexArray((GLuint)0);
-    glBindBuffer(GL_ARRAY_BUFFER, (GLuint)0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (GLuint)0);
-    glBindFramebuffer(GL_FRAMEBUFFER, (GLint)0);
-    glBindRenderbuffer(GL_RENDERBUFFER, (GLuint)0);
+    bind_vertex_array((GLuint)0);
+    bind_array_buffer((GLuint)0);
+    bind_element_array_buffer((GLuint)0);
+    bind_framebuffer((GLint)0);
+    bind_renderbuffer((GLuint)0);
 }
 
 void RenderTarget::init_texture() {
     if (this->id == 0)
         return;
-    glActiveTexture(GL_TEXTURE0 + this->id);
     glGenTextures(1, &this->texture);
-    glBindTexture(GL_TEXTURE_2D, this->texture);
+    bind_texture_for_update(this->texture);
     TextureParams params = this->params;
     glTexImage2D(GL_TEXTURE_2D, 0, params.format,
                  params.width, params.height, 0,
@@ -1114,12 +1878,12 @@ void RenderTarget::init_buffer() {
     if (this->id == 0)
         return;
     glGenFramebuffers(1, &this->fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+    bind_framebuffer(this->fbo);
     glFramebufferTexture2D(
         GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 
         GL_TEXTURE_2D, this->texture, 0);
     glGenRenderbuffers(1, &this->rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, this->rbo);
+    bind_renderbuffer(this->rbo);
     glRenderbufferStorage(
         GL_RENDERBUFFER, GL_DEPTH_STENCIL, 
         this->params.width, this->params.height
@@ -1130,9 +1894,9 @@ void RenderTarget::init_buffer() {
 
 void RenderTarget::adjust_viewport_before_drawing(const Config config) {
     if (config.usage == Config::VIEWPORT) {
-        glViewport(config.x0, config.y0, config.width, config.height);
+        set_viewport(config.x0, config.y0, config.width, config.height);
     } else {
-        glViewport(0, 0, this->params.width, this->params.height);
+        set_viewport(0, 0, this->params.width, this->params.height);
     }
 }
 
@@ -1148,6 +1912,22 @@ int RenderTarget::get_id() const {
     return this->id;
 }
 
+const TextureParams &RenderTarget::get_params() const {
+    return this->params;
+}
+
+void RenderTarget::swap(RenderTarget &other) {
+    std::swap(this->id, other.id);
+    std::swap(this->params, other.params);
+    std::swap(this->texture, other.texture);
+    std::swap(this->fbo, other.fbo);
+    std::swap(this->rbo, other.rbo);
+}
+
+int RenderTarget::bind_to_texture_unit() const {
+    return bind_texture_unit(this->texture);
+}
+
 IVec2 RenderTarget::texture_dimensions() const {
     return {.x=(int)this->params.width,
             .y=(int)this->params.height};
@@ -1156,83 +1936,149 @@ IVec2 RenderTarget::texture_dimensions() const {
 void RenderTarget::clear() {
     if (this->id == 0)
         return;
-    glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, this->rbo);
+    bind_framebuffer(this->fbo);
+    bind_renderbuffer(this->rbo);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glBindFramebuffer(GL_FRAMEBUFFER, (GLint)NULL);
-    glBindRenderbuffer(GL_RENDERBUFFER, (GLint)NULL);
+}
+
+/* Set the uniforms of the program currently in use. */
+static void set_uniform(GLint location, const Uniform &value) {
+    switch(value.type) {
+        case Uniform::BOOL:
+        break;
+        case Uniform::FLOAT:
+        glUniform1f(location, value.f32);
+        break;
+        case Uniform::FLOAT2:
+        glUniform2f(location, value.vec2[0], value.vec2[1]);
+        break;
+        case Uniform::FLOAT3:
+        glUniform3f(
+            location, value.vec3[0], value.vec3[1], value.vec3[2]);
+        break;
+        case Uniform::FLOAT4:
+        glUniform4f(
+            location, 
+            value.vec4[0], value.vec4[1], value.vec4[2], value.vec4[3]
+        );
+        break;
+        case Uniform::INT:
+        glUniform1i(location, value.i32);
+        break;
+        case Uniform::INT2:
+        glUniform2i(location, value.ivec2[0], value.ivec2[1]);
+        break;
+        case Uniform::INT3:
+        glUniform3i(
+            location, value.ivec3[0], value.ivec3[1], value.ivec3[2]);
+        break;
+        case Uniform::INT4:
+        glUniform4i(
+            location, 
+            value.ivec4[0], value.ivec4[1], value.ivec4[2], value.ivec4[3]
+        );
+        break;
+        case Uniform::QUATERNION:
+        glUniform4f(
+            location, 
+            value.quaternion.i, value.quaternion.j, value.quaternion.k,
+            value.quaternion.real
+        );
+        break;
+        // Samplers that the program does not use do not take a unit.
+        case Uniform::QUAD:
+        if (location >= 0)
+            glUniform1i(location, value.quad->bind_to_texture_unit());
+        break;
+        case Uniform::RENDER_TARGET:
+        if (location >= 0)
+            glUniform1i(
+                location, value.render_target->bind_to_texture_unit());
+        break;
+        case Uniform::MULTIDIMENSIONAL_DATA_QUAD:
+        if (location >= 0)
+            glUniform1i(
+                location,
+                value.multidimensional_data_quad->bind_to_texture_unit());
+    }
+}
+
+// Each of these is called once per draw.
+static void set_uniforms(uint32_t program, const Uniforms &uniforms) {
+    begin_texture_units_draw();
+    for (auto &uniform: uniforms) {
+        GLint location = glGetUniformLocation(program, uniform.first.c_str());
+        set_uniform(location, uniform.second);
+    }
+}
+
+static void set_uniforms(const Program &program, const Uniforms &uniforms) {
+    begin_texture_units_draw();
+    for (auto &uniform: uniforms)
+        set_uniform(program.uniform_location(uniform.first), uniform.second);
+}
+
+static void set_uniforms(UniformBindings uniforms) {
+    begin_texture_units_draw();
+    for (auto &uniform: uniforms)
+        set_uniform(uniform.location, uniform.value);
 }
 
 void RenderTarget::draw(
     uint32_t program,
     const Uniforms &uniforms, WireFrame &wire_frame,
     const Config config) {
-    int original_viewport[4] = {0,};
-    glGetIntegerv(GL_VIEWPORT, original_viewport);
     this->adjust_viewport_before_drawing(config);
-    glUseProgram(program);
-    if (this->id != 0) {
-        glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
-        glBindRenderbuffer(GL_RENDERBUFFER, this->rbo);
-    }
-    for (auto &uniform: uniforms) {
-        GLint location = glGetUniformLocation(program, uniform.first.c_str());
-        Uniform value = uniform.second;
-        switch(value.type) {
-            case Uniform::BOOL:
-            break;
-            case Uniform::FLOAT:
-            glUniform1f(location, value.f32);
-            break;
-            case Uniform::FLOAT2:
-            glUniform2f(location, value.vec2[0], value.vec2[1]);
-            break;
-            case Uniform::FLOAT3:
-            glUniform3f(
-                location, value.vec3[0], value.vec3[1], value.vec3[2]);
-            break;
-            case Uniform::FLOAT4:
-            glUniform4f(
-                location, 
-                value.vec4[0], value.vec4[1], value.vec4[2], value.vec4[3]
-            );
-            break;
-            case Uniform::INT:
-            glUniform1i(location, value.i32);
-            break;
-            case Uniform::INT2:
-            glUniform2i(location, value.ivec2[0], value.ivec2[1]);
-            break;
-            case Uniform::INT3:
-            glUniform3i(
-                location, value.ivec3[0], value.ivec3[1], value.ivec3[2]);
-            break;
-            case Uniform::INT4:
-            glUniform4i(
-                location, 
-                value.ivec4[0], value.ivec4[1], value.ivec4[2], value.ivec4[3]
-            );
-            break;
-            case Uniform::QUATERNION:
-            glUniform4f(
-                location, 
-                value.quaternion.i, value.quaternion.j, value.quaternion.k, 
-                value.quaternion.real);
-            break;
-            case Uniform::QUAD:
-            glUniform1i(location, value.quad->get_id());
-            break;
-            case Uniform::RENDER_TARGET:
-            glUniform1i(location, value.render_target->id);
-            break;
-            case Uniform::MULTIDIMENSIONAL_DATA_QUAD:
-            glUniform1i(location, value.multidimensional_data_quad->get_id());
-        }
-    }
+    use_program(program);
+    bind_framebuffer((this->id != 0)? this->fbo: 0);
+    set_uniforms(program, uniforms);
+    wire_frame.draw(program);
+}
+
+void RenderTarget::draw(
+    const Program &program,
+    const Uniforms &uniforms, WireFrame &wire_frame,
+    const Config config) {
+    this->adjust_viewport_before_drawing(config);
+    use_program(program);
+    bind_framebuffer((this->id != 0)? this->fbo: 0);
+    set_uniforms(program, uniforms);
     wire_frame.draw(program);
-    glViewport(original_viewport[0], original_viewport[1],
-               original_viewport[2], original_viewport[3]);
-    unbind();
+}
+
+void RenderTarget::draw(
+    const Program &program,
+    UniformBindings uniforms, WireFrame &wire_frame,
+    const Config config) {
+    this->adjust_viewport_before_drawing(config);
+    use_program(program);
+    bind_framebuffer((this->id != 0)? this->fbo: 0);
+    set_uniforms(uniforms);
+    wire_frame.draw(program);
+}
+
+// Drawing without any vertex attributes still needs a vertex array
+// bound in the core profile.
+static uint32_t s_empty_vertex_array = 0;
+
+void RenderTarget::draw(
+    const Program &program,
+    const Uniforms &uniforms, const Instances &instances,
+    const Config config) {
+    this->adjust_viewport_before_drawing(config);
+    use_program(program);
+    bind_framebuffer((this->id != 0)? this->fbo: 0);
+    set_uniforms(program, uniforms);
+    if (s_empty_vertex_array == 0)
+        glGenVertexArrays(1, &s_empty_vertex_array);
+    bind_vertex_array(s_empty_vertex_array);
+    GLenum mode = GL_TRIANGLES;
+    if (instances.draw_type == WireFrame::LINES)
+        mode = GL_LINES;
+    else if (instances.draw_type == WireFrame::POINTS)
+        mode = GL_POINTS;
+    glDrawArraysInstanced(
+        mode, 0, instances.vertex_count, instances.instance_count);
 }
 
 struct {
@@ -1251,13 +2097,13 @@ static const int QUAD_ELEMENTS[6] = {
 static void init_s_quad_objects() {
     if (!s_quad_objects.is_initialized) {
         glGenVertexArrays(1, &s_quad_objects.vao);
-        glBindVertexArray(s_quad_objects.vao);
+        bind_vertex_array(s_quad_objects.vao);
         glGenBuffers(1, &s_quad_objects.vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, s_quad_objects.vbo);
+        bind_array_buffer(s_quad_objects.vbo);
         glBufferData(GL_ARRAY_BUFFER, 
             sizeof(QUAD_VERTICES), QUAD_VERTICES, GL_STATIC_DRAW);
         glGenBuffers(1, &s_quad_objects.ebo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_quad_objects.ebo);
+        bind_element_array_buffer(s_quad_objects.ebo);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(QUAD_ELEMENTS), 
                      QUAD_ELEMENTS, GL_STATIC_DRAW);
         s_quad_objects.is_initialized = true;
@@ -1268,9 +2114,8 @@ static void init_s_quad_objects() {
 void Quad::init_texture() {
     if (this->id == 0)
         return;
-    glActiveTexture(GL_TEXTURE0 + this->id);
     glGenTextures(1, &this->texture);
-    glBindTexture(GL_TEXTURE_2D, this->texture);
+    bind_texture_for_update(this->texture);
     TextureParams params = this->params;
     glTexImage2D(GL_TEXTURE_2D, 0, 
                  params.format, params.width, params.height, 0, 
@@ -1288,29 +2133,26 @@ void Quad::init_buffer() {
     init_s_quad_objects();
     if (this->id != 0) {
         glGenFramebuffers(1, &this->fbo);
-        glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+        bind_framebuffer(this->fbo);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 
                                GL_TEXTURE_2D, this->texture, 0);
     }
 }
 
 // TODO!
-void Quad::bind(uint32_t program) {
-    glUseProgram(program);
-    glBindVertexArray(s_quad_objects.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, s_quad_objects.vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_quad_objects.ebo);
+void Quad::bind(uint32_t program, int position_location) {
+    use_program(program);
+    bind_vertex_array(s_quad_objects.vao);
+    bind_array_buffer(s_quad_objects.vbo);
+    bind_element_array_buffer(s_quad_objects.ebo);
     // if (s_quad_objects.vao == 0) {
     //     glBufferData(GL_ARRAY_BUFFER, 
     //         sizeof(QUAD_VERTICES), QUAD_VERTICES, GL_STATIC_DRAW);
     //     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(QUAD_ELEMENTS), 
     //                  QUAD_ELEMENTS, GL_STATIC_DRAW);
     // }
-    if (this->id != 0) {
-        glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
-        // glClear(GL_COLOR_BUFFER_BIT);
-    }
-    uint32_t attrib = glGetAttribLocation(program, "position");
+    bind_framebuffer((this->id != 0)? this->fbo: 0);
+    uint32_t attrib = position_location;
     glEnableVertexAttribArray(attrib);
     glVertexAttribPointer(attrib, 3, GL_FLOAT, GL_FALSE, 12, NULL);
 
@@ -1318,9 +2160,9 @@ void Quad::bind(uint32_t program) {
 
 void Quad::adjust_viewport_before_drawing(const Config config) {
     if (config.usage == Config::VIEWPORT) {
-        glViewport(config.x0, config.y0, config.width, config.height);
+        set_viewport(config.x0, config.y0, config.width, config.height);
     } else {
-        glViewport(0, 0, this->width(), this->height());
+        set_viewport(0, 0, this->width(), this->height());
     }
 }
 
@@ -1377,7 +2219,9 @@ Quad& Quad::operator=(Quad && r_val) {
         // delete its contents, cache its original id for later use,
         // and replace everything with the rvalue's. Set the rvalue's id
         // to 0 to notify the destructor to not delete the moved contents.
+        forget_texture(this->texture);
         glDeleteTextures(1, &this->texture);
+        forget_framebuffer(this->fbo);
         glDeleteFramebuffers(1, &this->fbo);
         s_removed_frames.push_back(this->get_id());
         this->id = r_val.id;
@@ -1399,7 +2243,9 @@ Quad::~Quad() {
     if (this->id == 0)
         return;
     std::cout << "Destructor called for " << this->id << std::endl;
+    forget_texture(this->texture);
     glDeleteTextures(1, &this->texture);
+    forget_framebuffer(this->fbo);
     glDeleteFramebuffers(1, &this->fbo);
     s_removed_frames.push_back(this->get_id());
 }
@@ -1411,25 +2257,12 @@ uint32_t Quad::make_program_from_path(std::string fragment_path) {
 }
 
 uint32_t Quad::make_program_from_source(std::string fragment_source) {
-    uint32_t vs_ref = shader_from_source(
-        std::string(QUAD_VERTEX_SHADER), GL_VERTEX_SHADER);
-    uint32_t fs_ref = shader_from_source(
-        fragment_source, GL_FRAGMENT_SHADER);
-    uint32_t program = glCreateProgram();
-    if (program == 0) {
-        fprintf(stderr, "Unable to create program.\n");
-    }
-    glAttachShader(program, vs_ref);
-    glAttachShader(program, fs_ref);
-    glLinkProgram(program);
-    GLint status;
-    char buf[1024] = {'\0',};
-    glGetProgramiv(program, GL_LINK_STATUS, &status);
-    glGetProgramInfoLog(program, 1023, NULL, buf);
-    if (status != GL_TRUE) {
-        fprintf(stderr, "%s\n%s\n", "Failed to link program:", buf);
-    }
-    glUseProgram(program);
+    std::string cache_path;
+    uint32_t program = begin_program(
+        {{.type=GL_VERTEX_SHADER, .source=QUAD_VERTEX_SHADER},
+         {.type=GL_FRAGMENT_SHADER, .source=fragment_source}}, cache_path);
+    finish_program(program, cache_path);
+    use_program(program);
     return program;
 }
 
@@ -1455,37 +2288,42 @@ void Quad::make_program_from_source(
         fprintf(stderr, "%s\n%s\n", "Failed to link program:", buf);
         return;
     }
-    glUseProgram(program);
+    use_program(program);
 }
 
 int Quad::get_id() const {
     return this->id;
 }
 
+const TextureParams &Quad::get_params() const {
+    return this->params;
+}
+
+void Quad::swap(Quad &other) {
+    std::swap(this->id, other.id);
+    std::swap(this->params, other.params);
+    std::swap(this->texture, other.texture);
+    std::swap(this->fbo, other.fbo);
+}
+
+int Quad::bind_to_texture_unit() const {
+    return bind_texture_unit(this->texture);
+}
+
 void Quad::clear() {
     if (this->id != 0) {
-        glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+        bind_framebuffer(this->fbo);
         // glBindFramebuffer(GL_RENDERBUFFER, this->rbo);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)0);
-        // glBindRenderbuffer(GL_RENDERBUFFER, (unsigned int)0);
     }
 }
 
 void Quad::substitute_array(void *array, IVec4 viewport) {
-    int old_viewport[4] = {0,};
-    glGetIntegerv(GL_VIEWPORT, old_viewport);
-    glViewport(0, 0, this->width(), this->height());
-    if (this->id != 0)
-        glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
-    glActiveTexture(GL_TEXTURE0 + this->id);
+    bind_texture_for_update(this->texture);
     glTexSubImage2D(
         GL_TEXTURE_2D, 0,
         viewport[0], viewport[1], viewport[2], viewport[3],
         to_base(this->format()), to_type(this->format()), array);
-    glViewport(old_viewport[0], old_viewport[1],
-        old_viewport[2], old_viewport[3]);
-    unbind();
 }
 
 void Quad::set_pixels(std::vector<float> vec) {
@@ -1507,14 +2345,12 @@ void Quad::set_pixels(float *vec) {
 }
 
 std::vector<float> Quad::get_float_pixels(IVec4 viewport) {
-    if (this->id != 0)
-        glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+    bind_framebuffer((this->id != 0)? this->fbo: 0);
     int size = this->width()*this->height()
         *number_of_channels(this->format());
     std::vector<float> vec(size);
     glReadPixels(viewport[0], viewport[1], viewport[2], viewport[3],
         to_base(this->format()), GL_FLOAT, (void *)&vec[0]);
-    unbind();
     return vec;
 }
 
@@ -1524,14 +2360,12 @@ std::vector<float> Quad::get_float_pixels() {
 }
  
 std::vector<uint8_t> Quad::get_byte_pixels(IVec4 viewport) {
-    if (this->id != 0)
-        glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+    bind_framebuffer((this->id != 0)? this->fbo: 0);
     size_t size = this->width()*this->height()
         *number_of_channels(this->format());
     std::vector<uint8_t> vec(size);
     glReadPixels(viewport[0], viewport[1], viewport[2], viewport[3],
         to_base(this->format()), GL_UNSIGNED_BYTE, (void *)&vec[0]);
-    unbind();
     return vec;
 }
 
@@ -1543,15 +2377,16 @@ std::vector<uint8_t> Quad::get_byte_pixels() {
 void Quad::reset(const TextureParams &new_tex_params) {
     if (this->id != 0) {
         this->params = new_tex_params;
-        glActiveTexture(GL_TEXTURE0 + this->id);
         uint32_t texture;
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        bind_texture_for_update(texture);
         glTexImage2D(GL_TEXTURE_2D, 0, 
                  params.format, params.width, params.height, 0, 
                  to_base(params.format), to_type(params.format), NULL);
+        forget_texture(this->texture);
         glDeleteTextures(1, &this->texture);
         this->texture = texture;
+        forget_framebuffer(this->fbo);
         glDeleteFramebuffers(1, &this->fbo);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, params.wrap_s);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, params.wrap_t);
@@ -1560,7 +2395,7 @@ void Quad::reset(const TextureParams &new_tex_params) {
         if (params.generate_mipmap)
             glGenerateMipmap(GL_TEXTURE_2D);
         glGenFramebuffers(1, &this->fbo);
-        glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+        bind_framebuffer(this->fbo);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 
                                GL_TEXTURE_2D, this->texture, 0);
     }
@@ -1579,71 +2414,26 @@ uint32_t Quad::format() const {
 }
 
 void Quad::draw(uint32_t program, const Uniforms &uniforms, const Config config) {
-    int old_viewport[4] = {0,};
-    glGetIntegerv(GL_VIEWPORT, old_viewport);
     this->adjust_viewport_before_drawing(config);
-    this->bind(program);
-    for (auto &uniform: uniforms) {
-        GLint location = glGetUniformLocation(program, uniform.first.c_str());
-        Uniform value = uniform.second;
-        switch(value.type) {
-            case Uniform::BOOL:
-            break;
-            case Uniform::FLOAT:
-            glUniform1f(location, value.f32);
-            break;
-            case Uniform::FLOAT2:
-            glUniform2f(location, value.vec2[0], value.vec2[1]);
-            break;
-            case Uniform::FLOAT3:
-            glUniform3f(
-                location, value.vec3[0], value.vec3[1], value.vec3[2]);
-            break;
-            case Uniform::FLOAT4:
-            glUniform4f(
-                location, 
-                value.vec4[0], value.vec4[1], value.vec4[2], value.vec4[3]
-            );
-            break;
-            case Uniform::INT:
-            glUniform1i(location, value.i32);
-            break;
-            case Uniform::INT2:
-            glUniform2i(location, value.ivec2[0], value.ivec2[1]);
-            break;
-            case Uniform::INT3:
-            glUniform3i(
-                location, value.ivec3[0], value.ivec3[1], value.ivec3[2]);
-            break;
-            case Uniform::INT4:
-            glUniform4i(
-                location, 
-                value.ivec4[0], value.ivec4[1], value.ivec4[2], value.ivec4[3]
-            );
-            break;
-            case Uniform::QUATERNION:
-            glUniform4f(
-                location, 
-                value.quaternion.i, value.quaternion.j, value.quaternion.k,
-                value.quaternion.real
-            );
-            break;
-            case Uniform::QUAD:
-            glUniform1i(location, value.quad->id);
-            break;
-            case Uniform::RENDER_TARGET:
-            glUniform1i(location, value.render_target->get_id());
-            break;
-            case Uniform::MULTIDIMENSIONAL_DATA_QUAD:
-            glUniform1i(
-                location, value.multidimensional_data_quad->get_id());
-            
-        }
-    }
+    this->bind(program, glGetAttribLocation(program, "position"));
+    set_uniforms(program, uniforms);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
+}
+
+void Quad::draw(
+    const Program &program, const Uniforms &uniforms, const Config config) {
+    this->adjust_viewport_before_drawing(config);
+    this->bind(program, program.attribute_location("position"));
+    set_uniforms(program, uniforms);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
+}
+
+void Quad::draw(
+    const Program &program, UniformBindings uniforms, const Config config) {
+    this->adjust_viewport_before_drawing(config);
+    this->bind(program, program.attribute_location("position"));
+    set_uniforms(uniforms);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
-    glViewport(old_viewport[0], old_viewport[1],
-               old_viewport[2], old_viewport[3]);
-    unbind();
 }
 
 static IVec2 compute_texture_dimensions(std::vector<int> data_dimensions) {
@@ -1682,6 +2472,10 @@ int MultidimensionalDataQuad::get_id() const {
     return this->quad.get_id();
 }
 
+int MultidimensionalDataQuad::bind_to_texture_unit() const {
+    return this->quad.bind_to_texture_unit();
+}
+
 void MultidimensionalDataQuad::clear() {
     this->quad.clear();
 }
@@ -1730,6 +2524,430 @@ uint32_t MultidimensionalDataQuad::make_program_from_source(
     return Quad::make_program_from_path(source);
 }
 
+PixelUnpackBuffers::PixelUnpackBuffers():
+    size(0), index(0), mapped(NULL) {
+    this->buffers[0] = 0;
+    this->buffers[1] = 0;
+}
+
+void PixelUnpackBuffers::resize(size_t size) {
+    if (size == this->size)
+        return;
+    this->unmap();
+    if (this->buffers[0] == 0)
+        glGenBuffers(2, this->buffers);
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffers[i]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size*sizeof(float),
+                     NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    #ifdef __EMSCRIPTEN__
+    this->staging.resize(size);
+    #endif
+    this->size = size;
+}
+
+size_t PixelUnpackBuffers::get_size() const {
+    return this->size;
+}
+
+float *PixelUnpackBuffers::map() {
+    if (this->mapped != NULL || this->size == 0)
+        return this->mapped;
+    #ifdef __EMSCRIPTEN__
+    this->mapped = &this->staging[0];
+    #else
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffers[this->index]);
+    // Invalidating the buffer lets the driver hand out fresh memory if
+    // its previous contents are still being read.
+    this->mapped = (float *)glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, this->size*sizeof(float),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (this->mapped == NULL)
+        fprintf(stderr, "Unable to map pixel unpack buffer.\n");
+    #endif
+    return this->mapped;
+}
+
+void PixelUnpackBuffers::unmap() {
+    if (this->mapped == NULL)
+        return;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffers[this->index]);
+    #ifdef __EMSCRIPTEN__
+    glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, this->size*sizeof(float),
+                    this->mapped);
+    #else
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    #endif
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    this->mapped = NULL;
+}
+
+void PixelUnpackBuffers::upload(Quad &dst) {
+    if (this->mapped == NULL)
+        return;
+    this->unmap();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffers[this->index]);
+    // With a pixel unpack buffer bound, the pointer is an offset into it.
+    dst.substitute_array(
+        NULL, {.ind{0, 0, (int)dst.width(), (int)dst.height()}});
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    this->index = 1 - this->index;
+}
+
+PixelUnpackBuffers::~PixelUnpackBuffers() {
+    if (this->buffers[0] == 0)
+        return;
+    this->unmap();
+    glDeleteBuffers(2, this->buffers);
+}
+
+#ifdef __EMSCRIPTEN__
+// WebGL 2 has no buffer mapping, but reads buffers back through
+// getBufferSubData, which Emscripten exposes under this name.
+extern "C" void glGetBufferSubData(GLenum, GLintptr, GLsizeiptr, void *);
+#endif
+
+PixelPackBuffers::PixelPackBuffers(): reads(), serial(0) {}
+
+void PixelPackBuffers::queue(
+    const Quad &src, IVec4 viewport, uint32_t type, size_t element_size,
+    void *dst, std::function<void()> on_complete) {
+    size_t size = size_t(viewport[2])*size_t(viewport[3])
+        *number_of_channels(src.format())*element_size;
+    // Prefer a free buffer that is already large enough, then any free
+    // buffer, and only then a new one.
+    Read *read = NULL;
+    for (Read &r: this->reads) {
+        if (r.fence != NULL)
+            continue;
+        if (read == NULL || (read->capacity < size && r.capacity >= size))
+            read = &r;
+    }
+    if (read == NULL) {
+        this->reads.push_back(
+            {.buffer=0, .capacity=0, .size=0, .serial=0, .fence=NULL,
+             .dst=NULL, .on_complete=nullptr});
+        read = &this->reads.back();
+        glGenBuffers(1, &read->buffer);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, read->buffer);
+    if (read->capacity < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        read->capacity = size;
+    }
+    bind_framebuffer((src.id != 0)? src.fbo: 0);
+    // With a pixel pack buffer bound, the pointer is an offset into it.
+    glReadPixels(viewport[0], viewport[1], viewport[2], viewport[3],
+                 to_base(src.format()), type, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    read->size = size;
+    read->serial = this->serial++;
+    read->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    read->dst = dst;
+    read->on_complete = on_complete;
+}
+
+void PixelPackBuffers::complete(Read &read) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, read.buffer);
+    #ifdef __EMSCRIPTEN__
+    glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, read.size, read.dst);
+    #else
+    void *pixels = glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, read.size, GL_MAP_READ_BIT);
+    if (pixels != NULL) {
+        memcpy(read.dst, pixels, read.size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        fprintf(stderr, "Unable to map pixel pack buffer.\n");
+    }
+    #endif
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glDeleteSync(read.fence);
+    read.fence = NULL;
+    read.dst = NULL;
+    // The callback may queue further reads, which can move this one.
+    std::function<void()> on_complete = std::move(read.on_complete);
+    read.on_complete = nullptr;
+    if (on_complete)
+        on_complete();
+}
+
+void PixelPackBuffers::read(
+    const Quad &src, float *dst, std::function<void()> on_complete) {
+    this->read(src, {.ind{0, 0, (int)src.width(), (int)src.height()}},
+               dst, on_complete);
+}
+
+void PixelPackBuffers::read(
+    const Quad &src, IVec4 viewport, float *dst,
+    std::function<void()> on_complete) {
+    this->queue(src, viewport, GL_FLOAT, sizeof(float), dst, on_complete);
+}
+
+void PixelPackBuffers::read(
+    const Quad &src, uint8_t *dst, std::function<void()> on_complete) {
+    this->read(src, {.ind{0, 0, (int)src.width(), (int)src.height()}},
+               dst, on_complete);
+}
+
+void PixelPackBuffers::read(
+    const Quad &src, IVec4 viewport, uint8_t *dst,
+    std::function<void()> on_complete) {
+    this->queue(src, viewport, GL_UNSIGNED_BYTE, sizeof(uint8_t),
+                dst, on_complete);
+}
+
+int PixelPackBuffers::oldest() const {
+    int index = -1;
+    for (size_t i = 0; i < this->reads.size(); i++) {
+        const Read &read = this->reads[i];
+        if (read.fence != NULL
+            && (index < 0 || read.serial < this->reads[index].serial))
+            index = i;
+    }
+    return index;
+}
+
+size_t PixelPackBuffers::poll() {
+    // Fences are passed in the order they were issued, so the reads are
+    // completed in the order they were queued, up to the first that is
+    // still in flight.
+    for (int i = this->oldest(); i >= 0; i = this->oldest()) {
+        GLenum status = glClientWaitSync(
+            this->reads[i].fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        this->complete(this->reads[i]);
+    }
+    size_t in_flight = 0;
+    for (const Read &read: this->reads)
+        in_flight += (read.fence != NULL)? 1: 0;
+    return in_flight;
+}
+
+void PixelPackBuffers::finish() {
+    // WebGL cannot wait on a fence, but reading the buffer back waits for
+    // the pixels by itself.
+    #ifndef __EMSCRIPTEN__
+    wait_for_gpu();
+    #endif
+    for (int i = this->oldest(); i >= 0; i = this->oldest())
+        this->complete(this->reads[i]);
+}
+
+PixelPackBuffers::~PixelPackBuffers() {
+    for (Read &read: this->reads) {
+        if (read.fence != NULL)
+            glDeleteSync(read.fence);
+        glDeleteBuffers(1, &read.buffer);
+    }
+}
+
+StorageBuffer::StorageBuffer(): buffer(0), size(0) {}
+
+void StorageBuffer::resize(size_t size) {
+    if (size == this->size)
+        return;
+    #ifndef __EMSCRIPTEN__
+    if (this->buffer == 0)
+        glGenBuffers(1, &this->buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    #endif
+    this->size = size;
+}
+
+size_t StorageBuffer::get_size() const {
+    return this->size;
+}
+
+void StorageBuffer::set_data(const void *data, size_t size) {
+    #ifndef __EMSCRIPTEN__
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    #endif
+}
+
+void StorageBuffer::bind(uint32_t binding) const {
+    #ifndef __EMSCRIPTEN__
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, this->buffer);
+    #endif
+}
+
+void StorageBuffer::copy_from(const Quad &src) {
+    #ifndef __EMSCRIPTEN__
+    bind_framebuffer(src.fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, this->buffer);
+    // With a pixel pack buffer bound, the pointer is an offset into it.
+    glReadPixels(0, 0, src.width(), src.height(),
+                 to_base(src.format()), to_type(src.format()), NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    #endif
+}
+
+void StorageBuffer::copy_to(Quad &dst) const {
+    #ifndef __EMSCRIPTEN__
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffer);
+    dst.substitute_array(
+        NULL, {.ind{0, 0, (int)dst.width(), (int)dst.height()}});
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    #endif
+}
+
+StorageBuffer::~StorageBuffer() {
+    #ifndef __EMSCRIPTEN__
+    if (this->buffer != 0)
+        glDeleteBuffers(1, &this->buffer);
+    #endif
+}
+
+void dispatch_compute(
+    uint32_t program, const Uniforms &uniforms, IVec3 groups) {
+    #ifndef __EMSCRIPTEN__
+    use_program(program);
+    set_uniforms(program, uniforms);
+    glDispatchCompute(groups[0], groups[1], groups[2]);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT
+                    | GL_PIXEL_BUFFER_BARRIER_BIT);
+    #endif
+}
+
+void dispatch_compute(
+    const Program &program, UniformBindings uniforms, IVec3 groups) {
+    #ifndef __EMSCRIPTEN__
+    use_program(program);
+    set_uniforms(uniforms);
+    glDispatchCompute(groups[0], groups[1], groups[2]);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT
+                    | GL_PIXEL_BUFFER_BARRIER_BIT);
+    #endif
+}
+
+void wait_for_gpu() {
+    #ifndef __EMSCRIPTEN__
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // Only the first wait has to flush the commands before the fence.
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    for (GLenum status = GL_TIMEOUT_EXPIRED; status == GL_TIMEOUT_EXPIRED;
+         flags = 0)
+        status = glClientWaitSync(fence, flags, 1000000000);
+    glDeleteSync(fence);
+    #endif
+}
+
+// From ARB_timer_query and EXT_disjoint_timer_query, which the OpenGL ES
+// headers do not have.
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+bool gpu_timer_queries_supported() {
+    static int s_supported = -1;
+    if (s_supported >= 0)
+        return s_supported;
+    #ifdef __EMSCRIPTEN__
+    s_supported = has_extension("GL_EXT_disjoint_timer_query_webgl2");
+    #else
+    int major_version = 0, minor_version = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major_version);
+    glGetIntegerv(GL_MINOR_VERSION, &minor_version);
+    const char *version = (const char *)glGetString(GL_VERSION);
+    if (version != NULL && std::string(version).find("OpenGL ES") == 0)
+        s_supported = has_extension("GL_EXT_disjoint_timer_query");
+    else
+        s_supported = major_version > 3
+            || (major_version == 3 && minor_version >= 3)
+            || has_extension("GL_ARB_timer_query");
+    #endif
+    return s_supported;
+}
+
+/* Only WebGL and OpenGL ES tell whether the GPU was interrupted while
+timing, such as by the power management, which makes the times of every
+query in flight meaningless. Reading whether it was also resets it, so
+this counts how many times it was, which every GPUTimer can compare with
+the count when it last looked. */
+static size_t gpu_timer_disjoint_count() {
+    static size_t s_count = 0;
+    #ifndef __EMSCRIPTEN__
+    const char *version = (const char *)glGetString(GL_VERSION);
+    if (version == NULL || std::string(version).find("OpenGL ES") != 0)
+        return s_count;
+    #endif
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if (disjoint != 0)
+        s_count++;
+    return s_count;
+}
+
+GPUTimer::GPUTimer():
+    queries(), free_queries(), lost(0), disjoint_count(0) {}
+
+void GPUTimer::begin() {
+    if (!gpu_timer_queries_supported())
+        return;
+    uint32_t query = 0;
+    if (this->free_queries.empty()) {
+        glGenQueries(1, &query);
+    } else {
+        query = this->free_queries.back();
+        this->free_queries.pop_back();
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    this->queries.push_back(query);
+}
+
+void GPUTimer::end() {
+    if (!gpu_timer_queries_supported())
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+bool GPUTimer::poll(double &seconds) {
+    if (this->queries.empty())
+        return false;
+    size_t disjoint_count = gpu_timer_disjoint_count();
+    if (disjoint_count != this->disjoint_count) {
+        this->lost = this->queries.size();
+        this->disjoint_count = disjoint_count;
+    }
+    uint32_t query = this->queries.front();
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE)
+        return false;
+    // Nanoseconds, which are enough in 32 bits for the intervals of
+    // a single frame.
+    GLuint elapsed = 0;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT, &elapsed);
+    if (this->lost > 0) {
+        seconds = -1.0;
+        this->lost--;
+    } else {
+        seconds = 1e-9*double(elapsed);
+    }
+    this->queries.erase(this->queries.begin());
+    this->free_queries.push_back(query);
+    return true;
+}
+
+GPUTimer::~GPUTimer() {
+    for (uint32_t query: this->queries)
+        glDeleteQueries(1, &query);
+    for (uint32_t query: this->free_queries)
+        glDeleteQueries(1, &query);
+}
+
 MainQuad::MainQuad(int width, int height) {
     this->quad.id = 0;
     this->quad.params = {
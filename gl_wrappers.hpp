@@ -12,7 +12,10 @@ OpenGL for the first time.
 #define GL_SILENCE_DEPRECATION
 // #define GLFW_INCLUDE_GLCOREARB
 #define GLFW_INCLUDE_ES3
+#include <functional>
+#include <initializer_list>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <GLES3/gl3.h>
@@ -59,6 +62,8 @@ struct TextureParams {
     uint32_t min_filter, mag_filter; // GL_LINEAR, GL_NEAREST, etc
 };
 
+bool texture_params_equal(const TextureParams &, const TextureParams &);
+
 struct Attribute {
     uint32_t size;
     uint32_t type;
@@ -396,9 +401,155 @@ uint32_t make_program_from_sources(std::string, std::string);
 
 uint32_t make_program_from_paths(std::string, std::string);
 
+/* Sources to use for the files of the given paths, such as shaders
+compiled into the program, instead of reading them. */
+void set_embedded_files(const std::map<std::string, const char *> &files);
+
+/* Read the files that programs are made from out of this directory
+instead, where it has them, so that shaders can be edited without
+rebuilding. Paths are taken as relative to the directory, without any
+leading "./". */
+void set_file_override_directory(const std::string &directory);
+
+/* Keep the binaries of linked programs in the given directory, which is
+created along with its parents if needed, and load programs from there
+instead of compiling them again while their sources, the driver and the
+renderer stay the same. A binary that the driver rejects is replaced by
+compiling the program again. An empty directory, the default, turns this
+off, as does a context without any program binary formats, such as
+WebGL. */
+void set_program_binary_cache(const std::string &directory);
+
+/* Whether the current context can compile shaders in the background,
+through KHR_parallel_shader_compile or ARB_parallel_shader_compile. */
+bool parallel_shader_compile_supported();
+
+/* Whether the current context has compute shaders and shader storage
+buffers, which need OpenGL 4.3 or OpenGL ES 3.1. WebGL has neither. */
+bool compute_shaders_supported();
+
+/* Whether textures of the given sized format can be drawn to, which for
+many float formats depends on extensions such as EXT_color_buffer_float.
+The answer is cached for each format. */
+bool is_color_renderable(uint32_t format);
+
+/* Returns 0 if compute shaders are not supported, or on failure. */
+uint32_t make_compute_program_from_source(std::string);
+
+uint32_t make_compute_program_from_path(std::string);
+
+/* The wrappers keep a copy of the bound program, framebuffer, buffers,
+vertex array, textures and viewport, and skip any change that would leave
+these as they are, so that drawing never has to query the context.
+made counts the calls passed on to OpenGL, and avoided those that were
+skipped. */
+struct GLStateChangeCounts {
+    size_t made;
+    size_t avoided;
+};
+
+/* Call after changing any of the above state outside of the wrappers. */
+void invalidate_gl_state_cache();
+
+/* Counts since the last call. */
+GLStateChangeCounts take_gl_state_change_counts();
+
 typedef std::map<std::string, Uniform> Uniforms;
 typedef std::map<std::string, Attribute> Attributes;
 
+/* A uniform of a Program given by its location, as returned by
+Program::uniform_location. A list of these is passed to draw instead of
+Uniforms where a draw happens often enough that building a map of names and
+looking each of them up matter, as the list is held on the stack. */
+struct UniformBinding {
+    int location;
+    Uniform value;
+};
+
+typedef std::initializer_list<UniformBinding> UniformBindings;
+
+/* A linked program, with the locations of all of its active uniforms and
+attributes looked up once when it is made, instead of on every draw. It
+converts to the id of the program, so that it can be passed wherever one is
+expected. */
+class Program {
+    uint32_t id;
+    std::map<std::string, int> uniform_locations;
+    std::map<std::string, int> attribute_locations;
+    public:
+    Program();
+    Program(uint32_t id);
+    uint32_t get_id() const;
+    operator uint32_t() const;
+    /* -1 if the program has no active uniform or attribute of that name,
+    which GL ignores when setting it. */
+    int uniform_location(const std::string &name) const;
+    int attribute_location(const std::string &name) const;
+    /* Bind the uniform block of the given name to a binding point of
+    UniformBuffer::bind, if the program has one. */
+    void bind_uniform_block(const std::string &name, uint32_t binding) const;
+};
+
+/* A Program that is only made when it is first used, so that programs
+that are never used are never compiled. Where the context has
+KHR_parallel_shader_compile, start issues the compiling and linking right
+away, which the driver then works on in the background, and is_ready tells
+without waiting whether it is done. Elsewhere start does nothing, and the
+program is compiled on first use. Copies share the same program. */
+class LazyProgram {
+    struct State {
+        // An empty vertex path stands for the vertex shader of Quad
+        // programs.
+        std::string vertex_path;
+        std::string fragment_path;
+        std::string compute_path;
+        // Put before the source of every shader, after the version line.
+        std::string defines;
+        std::vector<std::pair<std::string, uint32_t>> uniform_blocks;
+        // The program being compiled and linked, before it is checked.
+        uint32_t pending;
+        std::string cache_path;
+        Program program;
+        bool made;
+    };
+    std::shared_ptr<State> state;
+    void begin() const;
+    public:
+    LazyProgram();
+    static LazyProgram quad(std::string fragment_path);
+    static LazyProgram from_paths(
+        std::string vertex_path, std::string fragment_path);
+    /* Made as Program() if compute shaders are not supported. */
+    static LazyProgram compute(std::string path);
+    /* A separate program from the same shaders, with the given lines,
+    such as #defines, put at the start of each of them. */
+    LazyProgram with_defines(const std::string &defines) const;
+    void start() const;
+    bool is_ready() const;
+    /* Whether the program has been made, that is whether it was used. */
+    bool is_made() const;
+    /* Waits for the program to finish linking, or first compiles it. */
+    const Program &get() const;
+    operator const Program &() const;
+    /* As Program::bind_uniform_block, once the program is made. */
+    void bind_uniform_block(const std::string &name, uint32_t binding);
+};
+
+/* A uniform buffer, for parameters that are shared by several programs
+and so are only uploaded once when they change, instead of once per program
+on every draw. Data is given in the std140 layout of the uniform block. */
+class UniformBuffer {
+    uint32_t buffer;
+    size_t size;
+    public:
+    UniformBuffer();
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+    void set_data(const void *data, size_t size);
+    void bind(uint32_t binding) const;
+    ~UniformBuffer();
+};
+
 class WireFrame {
     Attributes attributes;
     std::vector<float> vertices;
@@ -407,6 +558,8 @@ class WireFrame {
     uint32_t vbo;
     uint32_t ebo;
     int draw_type;
+    // With the attribute locations of cached if it is not null.
+    void draw(uint32_t program, const Program *cached);
     public:
     enum {
         TRIANGLES=0, LINES, POINTS
@@ -429,6 +582,7 @@ class WireFrame {
               int draw_type=WireFrame::TRIANGLES);*/
     // std::vector<float> get_vertices();
     void draw(uint32_t program);
+    void draw(const Program &program);
     WireFrame(const WireFrame &w);
     WireFrame& operator=(const WireFrame &w);
     const std::vector<float> &get_vertices(); // TODO
@@ -436,6 +590,15 @@ class WireFrame {
     ~WireFrame();
 };
 
+/* Instances of a shape that the vertex shader builds entirely from
+gl_VertexID and gl_InstanceID, with no vertex data at all, for drawing a
+large number of small shapes. draw_type is one of the types of WireFrame. */
+struct Instances {
+    int draw_type;
+    int vertex_count;
+    int instance_count;
+};
+
 class RenderTarget {
     size_t id;
     TextureParams params;
@@ -448,12 +611,32 @@ class RenderTarget {
     public:
     RenderTarget(TextureParams const &);
     int get_id() const;
+    const TextureParams &get_params() const;
+    /* Exchange the textures and frame buffers of the two, which is how
+    the contents of one are replaced by those of another without a copy. */
+    void swap(RenderTarget &other);
+    /* Bind the texture to a unit for sampling in the next draw, and
+    return that unit. This is done by the draw functions for every texture
+    passed as a uniform. */
+    int bind_to_texture_unit() const;
     IVec2 texture_dimensions() const;
     void clear();
     void draw(uint32_t program, 
               const Uniforms &uniforms, 
               WireFrame &wire_frame,
               const Config config = Config());
+    void draw(const Program &program,
+              const Uniforms &uniforms,
+              WireFrame &wire_frame,
+              const Config config = Config());
+    void draw(const Program &program,
+              UniformBindings uniforms,
+              WireFrame &wire_frame,
+              const Config config = Config());
+    void draw(const Program &program,
+              const Uniforms &uniforms,
+              const Instances &instances,
+              const Config config = Config());
 };
 
 class Quad {
@@ -463,12 +646,15 @@ class Quad {
     uint32_t fbo;
     void init_texture();
     void init_buffer();
-    void bind(uint32_t program);
+    void bind(uint32_t program, int position_location);
     void adjust_viewport_before_drawing(const Config config);
     Quad() {};
     void init(const TextureParams &);
     friend class MultidimensionalDataQuad;
     friend class MainQuad;
+    friend class PixelUnpackBuffers;
+    friend class PixelPackBuffers;
+    friend class StorageBuffer;
     void substitute_array(void *array, IVec4 viewport);
     public:
     Quad(const TextureParams &);
@@ -480,6 +666,11 @@ class Quad {
     static uint32_t make_program_from_source(std::string);
     static void make_program_from_source(uint32_t &, int &, std::string);
     int get_id() const;
+    const TextureParams &get_params() const;
+    /* Exchange the textures and frame buffers of the two, without a copy.
+    Neither may hold the main frame buffer. */
+    void swap(Quad &other);
+    int bind_to_texture_unit() const;
     void clear();
     void reset(const TextureParams &);
     uint32_t width() const;
@@ -487,6 +678,10 @@ class Quad {
     uint32_t format() const;
     void draw(uint32_t program, const Uniforms &uniforms,
               const Config = Config());
+    void draw(const Program &program, const Uniforms &uniforms,
+              const Config = Config());
+    void draw(const Program &program, UniformBindings uniforms,
+              const Config = Config());
     void set_pixels(std::vector<float>);
     void set_pixels(const std::vector<float> &, IVec4);
     void set_pixels(float *arr);
@@ -497,6 +692,158 @@ class Quad {
     ~Quad();
 };
 
+/* A pair of pixel unpack buffers for streaming new float pixels into a
+Quad on every frame. The pixels are written into one buffer while the
+upload from the other, queued on the previous frame, may still be in
+flight, and the upload itself is only queued, so that the CPU never waits on
+the transfer. */
+class PixelUnpackBuffers {
+    uint32_t buffers[2];
+    size_t size;
+    int index;
+    float *mapped;
+    #ifdef __EMSCRIPTEN__
+    // WebGL has no buffer mapping, so the pixels are staged here instead.
+    std::vector<float> staging;
+    #endif
+    void unmap();
+    public:
+    PixelUnpackBuffers();
+    PixelUnpackBuffers(const PixelUnpackBuffers &) = delete;
+    PixelUnpackBuffers &operator=(const PixelUnpackBuffers &) = delete;
+    /* Number of floats in each buffer. */
+    void resize(size_t size);
+    size_t get_size() const;
+    /* Pointer to the current buffer, which can be written by any thread
+    until the next call to upload. Returns the same pointer until then. */
+    float *map();
+    /* Queue the upload of the current buffer to every pixel of dst, and
+    switch to the other buffer. Does nothing if the buffer is not mapped. */
+    void upload(Quad &dst);
+    ~PixelUnpackBuffers();
+};
+
+/* Pixel pack buffers for reading the pixels of Quads back without
+stalling, as an alternative to get_float_pixels and get_byte_pixels. Each
+read is only queued, behind a fence, and its pixels are copied to the
+destination given by the caller once a later poll finds that the GPU has
+passed the fence. Any number of reads may be in flight at once, each in its
+own buffer, and the buffers are reused by later reads once they are done. */
+class PixelPackBuffers {
+    struct Read {
+        uint32_t buffer;
+        // Capacity of the buffer, and size of the current read, in bytes.
+        size_t capacity;
+        size_t size;
+        // Order in which the reads in flight were queued.
+        size_t serial;
+        // NULL once the read is done.
+        GLsync fence;
+        void *dst;
+        std::function<void()> on_complete;
+    };
+    std::vector<Read> reads;
+    size_t serial;
+    void queue(const Quad &src, IVec4 viewport, uint32_t type,
+               size_t element_size, void *dst,
+               std::function<void()> on_complete);
+    void complete(Read &read);
+    // Index of the read in flight that was queued first, or -1.
+    int oldest() const;
+    public:
+    PixelPackBuffers();
+    PixelPackBuffers(const PixelPackBuffers &) = delete;
+    PixelPackBuffers &operator=(const PixelPackBuffers &) = delete;
+    /* Queue reading the pixels of src within the viewport into dst, which
+    must have room for them, and must not be freed until on_complete is
+    called from poll or finish. */
+    void read(const Quad &src, float *dst,
+              std::function<void()> on_complete = nullptr);
+    void read(const Quad &src, IVec4 viewport, float *dst,
+              std::function<void()> on_complete = nullptr);
+    void read(const Quad &src, uint8_t *dst,
+              std::function<void()> on_complete = nullptr);
+    void read(const Quad &src, IVec4 viewport, uint8_t *dst,
+              std::function<void()> on_complete = nullptr);
+    /* Complete every read that the GPU is done with, without waiting,
+    and return how many are still in flight. */
+    size_t poll();
+    /* Wait for and complete every read in flight. */
+    void finish();
+    /* Reads still in flight are dropped without completing. */
+    ~PixelPackBuffers();
+};
+
+/* A shader storage buffer, for data that compute shaders read and write.
+Unlike a Quad, its size is not bound by the largest texture size. */
+class StorageBuffer {
+    uint32_t buffer;
+    size_t size;
+    public:
+    StorageBuffer();
+    StorageBuffer(const StorageBuffer &) = delete;
+    StorageBuffer &operator=(const StorageBuffer &) = delete;
+    /* Size in bytes. The contents are undefined after it changes. */
+    void resize(size_t size);
+    size_t get_size() const;
+    void set_data(const void *data, size_t size);
+    /* Bind to the binding point given in the layout of a buffer block. */
+    void bind(uint32_t binding) const;
+    /* Copy every pixel of src, in the order they are read by
+    glReadPixels, or write them to every pixel of dst, without the data
+    leaving the GPU. src must be of a format with four channels. */
+    void copy_from(const Quad &src);
+    void copy_to(Quad &dst) const;
+    ~StorageBuffer();
+};
+
+/* Run a compute program over a grid of work groups, then make what it
+wrote to storage buffers visible to later dispatches and copies. */
+void dispatch_compute(
+    uint32_t program, const Uniforms &uniforms, IVec3 groups);
+
+void dispatch_compute(
+    const Program &program, UniformBindings uniforms, IVec3 groups);
+
+/* Block until every command issued so far has completed on the GPU, as
+PixelPackBuffers::finish does before completing its reads. WebGL cannot
+wait on a fence, so there this returns right away. */
+void wait_for_gpu();
+
+/* Whether GPUTimer can time commands, which needs GL 3.3 or
+ARB_timer_query on the desktop, EXT_disjoint_timer_query on OpenGL ES, and
+EXT_disjoint_timer_query_webgl2 in WebGL. */
+bool gpu_timer_queries_supported();
+
+/* Times how long the commands issued between each call to begin and end
+take on the GPU, with GL_TIME_ELAPSED queries, so that it can be timed
+without waiting for the GPU. The times are only known a few frames later,
+and are collected in the order of the intervals by poll. Only one interval
+of any GPUTimer may be open at a time. Does nothing if
+gpu_timer_queries_supported is false. */
+class GPUTimer {
+    // The queries of the intervals not yet collected, oldest first, and
+    // those that can be reused.
+    std::vector<uint32_t> queries;
+    std::vector<uint32_t> free_queries;
+    // How many of the oldest queries were in flight when the GPU was last
+    // interrupted, and how many times it had been by then.
+    size_t lost;
+    size_t disjoint_count;
+    public:
+    GPUTimer();
+    GPUTimer(const GPUTimer &) = delete;
+    GPUTimer &operator=(const GPUTimer &) = delete;
+    void begin();
+    void end();
+    /* If the oldest interval not yet collected has finished, set seconds to
+    how long it took and return true, without waiting. Seconds is negative
+    for an interval whose time was lost, as happens in WebGL and OpenGL ES
+    when the GPU is interrupted while timing. */
+    bool poll(double &seconds);
+    ~GPUTimer();
+};
+
 class MultidimensionalDataQuad {
     Quad quad;
     std::vector<int> data_dimensions;
@@ -505,6 +852,7 @@ class MultidimensionalDataQuad {
     MultidimensionalDataQuad(
         const std::vector<int> &, const TextureParams &);
     int get_id() const;
+    int bind_to_texture_unit() const;
     void clear();
     void reset(const std::vector<int> &, const TextureParams &);
     IVec2 get_texture_dimensions() const;
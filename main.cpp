@@ -2,6 +2,7 @@
 #include "glfw_window.hpp"
 #include "simulation.hpp"
 #include "interactor.hpp"
+#include "frame_scheduler.hpp"
 #include <GLFW/glfw3.h>
 
 #ifdef __EMSCRIPTEN__
@@ -11,6 +12,7 @@
 using namespace emscripten;
 #endif
 #include <functional>
+#include <algorithm>
 
 static std::function <void()> s_loop;
 #ifdef __EMSCRIPTEN__
@@ -34,7 +36,10 @@ void double_pendulum(
     Simulation sim(window_width, window_height, params);
     s_sim_params_set = [&params, &sim](int c, Uniform u) {
         params.set(c, u);
-        if (!(c == params.DT || c == params.STEPS_PER_FRAME) 
+        if (!(c == params.DT || c == params.STEPS_PER_FRAME
+              || c == params.STEP_SCHEDULING || c == params.FRAME_TIME
+              || c == params.CPU_THREADS || c == params.PIN_C_P_U_THREADS
+              || c == params.CPU_TOLERANCE_EXPONENT) 
                 || c == params.PENDULUM_DISPLAY_WITH_INITIAL_ANGLES) {
             sim.init_config(params);
         }
@@ -42,12 +47,35 @@ void double_pendulum(
     s_sim_params_get = [&params](int c) -> Uniform {
         return params.get(c);
     };
+    FrameScheduler scheduler {};
+    // Not set until the first frame.
+    int swap_interval = -1;
     s_loop = [&] {
-        for (int i = 0; i < params.stepsPerFrame; i++) {
-            if (i % 5 == 0)
-                main_render.draw(sim.view(params));
-            sim.time_step(params);
+        // Only the view drawn last before swapping buffers is ever seen, so
+        // it is drawn once per frame, after all the steps of the frame,
+        // which are passed as one batch.
+        bool timed = FrameScheduler::is_timed(params.stepScheduling);
+        int steps = scheduler.steps(
+            params.stepScheduling, params.stepsPerFrame,
+            params.frameTime/1000.0);
+        #ifndef __EMSCRIPTEN__
+        // Waiting for the vertical blank would hold back the uncapped
+        // steps.
+        int interval
+            = (params.stepScheduling == FrameScheduler::UNCAPPED)? 0: 1;
+        if (interval != swap_interval) {
+            glfwSwapInterval(interval);
+            swap_interval = interval;
         }
+        #endif
+        if (timed)
+            scheduler.start_steps();
+        sim.time_step(params, steps);
+        if (timed)
+            scheduler.end_steps();
+        main_render.draw(sim.view(params));
+        if (timed)
+            scheduler.end_draw();
         auto poll_events = [&] {
             interactor.click_update(main_render.get_window());
             if (interactor.left_pressed()) {
@@ -61,6 +89,16 @@ void double_pendulum(
         };
         poll_events();
         glfwSwapBuffers(main_render.get_window());
+        // Build with -DGL_STATE_DEBUG to see how many redundant GL state
+        // changes and passes are skipped every frame.
+        #ifdef GL_STATE_DEBUG
+        GLStateChangeCounts counts = take_gl_state_change_counts();
+        fprintf(stderr, "GL state changes: %zu made, %zu avoided.\n",
+                counts.made, counts.avoided);
+        RenderGraph::PassCounts pass_counts = sim.take_pass_counts();
+        fprintf(stderr, "Passes: %zu run, %zu skipped.\n",
+                pass_counts.run, pass_counts.skipped);
+        #endif
     };
     #ifdef __EMSCRIPTEN__
     emscripten_set_main_loop(s_main_loop, 0, true);
@@ -71,6 +109,23 @@ void double_pendulum(
 }
 
 
+/* Where the linked programs are kept between launches, which is per user,
+so that launches from any directory share it: PROGRAM_CACHE_DIR if set,
+where it being empty turns the cache off, and otherwise under
+XDG_CACHE_HOME or ~/.cache. */
+static std::string program_binary_cache_directory() {
+    const char *directory = getenv("PROGRAM_CACHE_DIR");
+    if (directory != NULL)
+        return directory;
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    if (cache_home != NULL && cache_home[0] != '\0')
+        return std::string(cache_home) + "/fractals-classical-mechanics";
+    const char *home = getenv("HOME");
+    if (home != NULL && home[0] != '\0')
+        return std::string(home) + "/.cache/fractals-classical-mechanics";
+    return "";
+}
+
 int main(int argc, char *argv[]) {
     int window_width = 2880, window_height = 1440;
 
@@ -80,6 +135,13 @@ int main(int argc, char *argv[]) {
         window_height = std::atoi(argv[2]);
     }
     auto main_quad = MainGLFWQuad(window_width, window_height);
+    // Later launches load the programs from here instead of compiling them.
+    set_program_binary_cache(program_binary_cache_directory());
+    // The shaders are compiled into the program, but for editing them
+    // without rebuilding, they are read from under this directory instead,
+    // such as the root of the repository, where it has them.
+    if (getenv("SHADER_OVERRIDE_DIR") != NULL)
+        set_file_override_directory(getenv("SHADER_OVERRIDE_DIR"));
     sim_2d::SimParams sim_params {};
     double_pendulum(main_quad, sim_params, window_width, window_height);
     return 1;
@@ -0,0 +1,457 @@
+"""Generate the C++ and GLSL kernels for the time derivatives of the
+double pendulum coordinates.
+
+The Hamiltonian is built in the same way as in symbolic.ipynb, but with
+c = cos(phi1 - phi2), cos(phi1) and cos(phi2) kept as plain symbols. The
+time derivatives of the momenta then follow from the chain rule:
+
+    dot_pi1 = -dH/dphi1 = sin(phi1 - phi2)*dH/dc + sin(phi1)*dH/dcos(phi1),
+    dot_pi2 = -dH/dphi2 = -sin(phi1 - phi2)*dH/dc + sin(phi2)*dH/dcos(phi2).
+
+dH/dc is rewritten in terms of the angular velocities dot_phi1 and dot_phi2,
+which need to be computed anyway, after which it is only a short quadratic
+form. Subexpressions that only depend on the pendulum parameters are hoisted
+out of the per-pendulum code, and common subexpression elimination is applied
+to the rest.
+
+Before anything is written, the generated code is evaluated numerically and
+compared against the derivatives of the Hamiltonian taken directly with
+cos(phi1 - phi2), which are the expressions that were previously pasted into
+the kernels. Generation fails if the two disagree.
+
+Outputs:
+ - double_pendulum_dots.hpp: DotsConstants and the templated
+   double_pendulum_dots() used by the CPU integrator.
+ - shaders/double-pendulum/dots.frag: the GPU equivalent.
+ - The dots() function of the single pass integration shaders in
+   shaders/integration, which is written between the GENERATED_BEGIN and
+   GENERATED_END lines of each, leaving the rest of the shader as it is.
+"""
+import math
+import random
+import sys
+import sympy
+from sympy.printing.c import C99CodePrinter
+from sympy.printing.precedence import precedence
+
+
+CPP_FILE_NAME = 'double_pendulum_dots.hpp'
+GLSL_FILE_NAME = 'shaders/double-pendulum/dots.frag'
+GLSL_INTEGRATOR_FILE_NAMES = [
+    'shaders/integration/rk4.frag',
+    'shaders/integration/gauss-legendre.frag',
+    'shaders/integration/extended-phase-space.frag',
+    'shaders/integration/integrate.comp',
+]
+GLSL_GENERATED_BEGIN = '// GENERATED_BEGIN by make_dots_kernels.py\n'
+GLSL_GENERATED_END = '// GENERATED_END\n'
+
+mass1, mass2, length1, length2, gravity = sympy.symbols(
+    'mass1 mass2 length1 length2 gravity', positive=True)
+PARAMETERS = (mass1, mass2, length1, length2, gravity)
+pi1, pi2, phi1, phi2 = sympy.symbols('pi1 pi2 phi1 phi2', real=True)
+sin1, cos1, sin2, cos2 = sympy.symbols('sin1 cos1 sin2 cos2', real=True)
+s, c = sympy.symbols('s c', real=True)
+dot_phi1_sym, dot_phi2_sym = sympy.symbols('dot_phi1 dot_phi2')
+
+# Parameter sets that get their own kernel, with the given values
+# substituted before optimizing so that any terms they cancel disappear.
+# They are matched in order, so more specific sets must come first.
+# Each entry is (name of the constants struct, enum name, values).
+PRESETS = [
+    ('UnitDotsConstants', 'DOTS_UNIT',
+     {mass1: 1, mass2: 1, length1: 1, length2: 1}),
+    ('UnitLengthDotsConstants', 'DOTS_UNIT_LENGTH',
+     {length1: 1, length2: 1}),
+]
+
+
+def dot_phi(pi1, pi2, cos_diff):
+    m11 = (mass1 + mass2)*length1
+    m12 = mass2*length1*length2*cos_diff
+    m21 = mass2*length1*length2*cos_diff
+    m22 = mass2*length2
+    det = m12*m21 - m22*m11
+    return ((-m22*pi1 + m12*pi2)/det, (m21*pi1 - m11*pi2)/det)
+
+
+def hamiltonian(pi1, pi2, cos_diff, cos_phi1, cos_phi2):
+    dot_phi1, dot_phi2 = dot_phi(pi1, pi2, cos_diff)
+    lagrangian = (
+        sympy.Rational(1, 2)*(mass1 + mass2)*(length1*dot_phi1)**2
+        + sympy.Rational(1, 2)*mass2*length2**2*dot_phi2**2
+        + mass2*length1*length2*dot_phi1*dot_phi2*cos_diff
+        + (mass1 + mass2)*gravity*length1*cos_phi1
+        + mass2*gravity*length2*cos_phi2)
+    return dot_phi1*pi1 + dot_phi2*pi2 - lagrangian
+
+
+def split_denominator(expr):
+    """Split expr into (numerator/constant, d), where expr equals
+    numerator/(constant*d) and d is the factor of the denominator that
+    depends on c."""
+    numer, denom = sympy.fraction(sympy.factor(expr))
+    d = sympy.Mul(*[f for f in sympy.Mul.make_args(denom)
+                    if f.has(c)])
+    return numer*d/denom, d
+
+
+def derive():
+    """Return the list of (symbol, expression) assignments that compute
+    dot_phi1, dot_phi2, dot_pi1 and dot_pi2 from s, c, sin1 and sin2.
+    """
+    dot_phi1, dot_phi2 = dot_phi(pi1, pi2, c)
+    h = hamiltonian(pi1, pi2, c, cos1, cos2)
+    momenta = sympy.solve(
+        [sympy.Eq(dot_phi1_sym, dot_phi1), sympy.Eq(dot_phi2_sym, dot_phi2)],
+        [pi1, pi2], dict=True)[0]
+    dh_dc = sympy.diff(h, c).subs(momenta)
+    inv_d = sympy.Symbol('inv_d')
+    dh_dc_sym = sympy.Symbol('dh_dc')
+    numer1, d = split_denominator(dot_phi1)
+    numer2, d2 = split_denominator(dot_phi2)
+    numer3, d3 = split_denominator(sympy.simplify(dh_dc))
+    assert sympy.simplify(d2 - d) == 0 and sympy.simplify(d3 - d) == 0
+    # dH/dc is a quadratic form in the angular velocities.
+    numer3 = sympy.collect(
+        sympy.expand(numer3),
+        [dot_phi1_sym**2, dot_phi2_sym**2, dot_phi1_sym*dot_phi2_sym],
+        evaluate=False)
+    numer3 = sum(sympy.horner(sympy.expand(v), wrt=c)*k
+                 for k, v in numer3.items())
+    numer1, numer2 = [sympy.collect(sympy.expand(n), [pi1, pi2])
+                      for n in (numer1, numer2)]
+    return [
+        (inv_d, 1/d),
+        (dot_phi1_sym, numer1*inv_d),
+        (dot_phi2_sym, numer2*inv_d),
+        (dh_dc_sym, numer3*inv_d),
+        (sympy.Symbol('dot_pi1'), s*dh_dc_sym + sin1*sympy.diff(h, cos1)),
+        (sympy.Symbol('dot_pi2'), -s*dh_dc_sym + sin2*sympy.diff(h, cos2)),
+    ]
+
+
+def is_constant(expr):
+    return expr.free_symbols <= set(PARAMETERS)
+
+
+def hoist_constants(expr, constants):
+    """Replace the parts of expr that only depend on the pendulum
+    parameters by symbols, recording them in constants."""
+    if is_constant(expr):
+        if expr.is_Number:
+            return expr
+        expr = sympy.factor(expr)
+        if expr not in constants:
+            constants[expr] = sympy.Symbol('k%d' % len(constants))
+        return constants[expr]
+    if expr.is_Atom:
+        return expr
+    if expr.is_Add or expr.is_Mul:
+        const_args = [a for a in expr.args if is_constant(a)]
+        other_args = [hoist_constants(a, constants)
+                      for a in expr.args if not is_constant(a)]
+        if const_args:
+            other_args.append(
+                hoist_constants(expr.func(*const_args), constants))
+        return expr.func(*other_args)
+    return expr.func(*[hoist_constants(a, constants) for a in expr.args])
+
+
+def optimize(assignments):
+    """Return (constants, statements), where constants are the hoisted
+    parameter-only expressions and statements the per-pendulum code."""
+    constants = {}
+    temporaries = sympy.numbered_symbols('t')
+    statements = []
+    # The assignments already share their common parts through the
+    # intermediate symbols, so each one is optimized on its own and
+    # its temporaries are emitted right before it.
+    for sym, expr in assignments:
+        replacements, reduced = sympy.cse(
+            [hoist_constants(expr, constants)], symbols=temporaries)
+        statements.extend(replacements)
+        statements.append((sym, reduced[0]))
+    constants = [(v, k) for k, v in constants.items()]
+    return constants, statements
+
+
+class KernelPrinter(C99CodePrinter):
+    """C printer that expands small integer powers into products,
+    prints every number as a floating point literal, optionally wrapped in
+    number_format, and prefixes the hoisted constants, so that the output is
+    valid for the SIMD vector types of any precision and for GLSL floats."""
+
+    def __init__(self, constant_prefix='', number_format='%s'):
+        super().__init__({'full_prec': False})
+        self.constant_prefix = constant_prefix
+        self.number_format = number_format
+        self.constant_names = set()
+
+    def _print_Symbol(self, expr):
+        if expr.name in self.constant_names:
+            return self.constant_prefix + expr.name
+        return expr.name
+
+    def _print_Pow(self, expr):
+        base, exp = expr.args
+        if exp.is_Integer and 0 < abs(exp) <= 4:
+            factor = self.parenthesize(base, precedence(expr))
+            product = '*'.join([factor]*abs(int(exp)))
+            if exp < 0:
+                return self._print(sympy.Integer(1)) + '/' \
+                    + (factor if exp == -1 else '(%s)' % product)
+            return product
+        return super()._print_Pow(expr)
+
+    def _print_Integer(self, expr):
+        return self.number_format % ('%d.0' % int(expr))
+
+    def _print_Rational(self, expr):
+        return self.number_format % ('(%d.0/%d.0)' % (expr.p, expr.q))
+
+    def _print_Float(self, expr):
+        return self.number_format % repr(float(expr))
+
+
+def check(constants, statements, fixed_values={},
+          sample_count=200, tolerance=1e-9):
+    """Evaluate the generated statements at random coordinates and
+    parameters and compare them with the derivatives of the Hamiltonian
+    written directly in terms of cos(phi1 - phi2). Parameters in
+    fixed_values are not sampled."""
+    h = hamiltonian(pi1, pi2, sympy.cos(phi1 - phi2),
+                    sympy.cos(phi1), sympy.cos(phi2))
+    dot_phi1, dot_phi2 = dot_phi(pi1, pi2, sympy.cos(phi1 - phi2))
+    args = (pi1, pi2, phi1, phi2) + PARAMETERS
+    reference = sympy.lambdify(
+        args, [-sympy.diff(h, phi1), -sympy.diff(h, phi2),
+               dot_phi1, dot_phi2], 'math')
+    program = [(sym, list(expr.free_symbols),
+                sympy.lambdify(list(expr.free_symbols), expr, 'math'))
+               for sym, expr in constants + statements]
+    random.seed(0)
+    worst = 0.0
+    for _ in range(sample_count):
+        coords = [random.uniform(-10.0, 10.0), random.uniform(-10.0, 10.0),
+                  random.uniform(-math.pi, math.pi),
+                  random.uniform(-math.pi, math.pi)]
+        params = [random.uniform(0.1, 10.0), random.uniform(0.1, 10.0),
+                  random.uniform(0.1, 2.0), random.uniform(0.1, 2.0),
+                  random.uniform(0.0, 20.0)]
+        params = [float(fixed_values.get(p, v))
+                  for p, v in zip(PARAMETERS, params)]
+        values = dict(zip(args, coords + params))
+        values[s] = math.sin(coords[2] - coords[3])
+        values[c] = math.cos(coords[2] - coords[3])
+        values[sin1] = math.sin(coords[2])
+        values[sin2] = math.sin(coords[3])
+        for sym, free, f in program:
+            values[sym] = f(*[values[x] for x in free])
+        expected = reference(*(coords + params))
+        actual = [values[sympy.Symbol(n)] for n in
+                  ('dot_pi1', 'dot_pi2', 'dot_phi1', 'dot_phi2')]
+        for e, a in zip(expected, actual):
+            worst = max(worst, abs(e - a)/max(1.0, abs(e)))
+    if worst > tolerance:
+        print(f'Generated kernels differ from the reference expressions '
+              f'(relative error {worst}).', file=sys.stderr)
+        sys.exit(1)
+    return worst
+
+
+def count_operations(statements):
+    return sum(sympy.count_ops(e) for _, e in statements)
+
+
+CPP_START = """/* Generated by make_dots_kernels.py. Do not edit.
+
+Time derivatives of the double pendulum coordinates. These are the
+Hamiltonian equations of motion of symbolic.ipynb, with common subexpressions
+eliminated, and with the factors that only depend on the pendulum parameters
+collected in DotsConstants so that they are computed once per kernel call.
+*/
+#include "simd.hpp"
+#include "cpu_integration.hpp"
+
+#ifndef _DOUBLE_PENDULUM_DOTS_
+#define _DOUBLE_PENDULUM_DOTS_
+
+"""
+
+CPP_KERNEL_START = """
+/* T is either a scalar type or one of the SIMD vector types. */
+template <typename T>
+SIMD_INLINE void double_pendulum_dots(
+    T &dot_pi1, T &dot_pi2, T &dot_phi1, T &dot_phi2,
+    const T &pi1, const T &pi2, const T &phi1, const T &phi2,
+    const {0}<typename SIMDTraits<T>::scalar> &k) {{
+    typedef typename SIMDTraits<T>::scalar S;
+    T sin1, cos1, sin2, cos2;
+    simd_sincos(phi1, sin1, cos1);
+    simd_sincos(phi2, sin2, cos2);
+    T s = sin1*cos2 - cos1*sin2;
+    T c = cos1*cos2 + sin1*sin2;
+"""
+
+OUTPUTS = ('dot_pi1', 'dot_pi2', 'dot_phi1', 'dot_phi2')
+
+
+def cpp_kernel(name, constants, statements):
+    """The constants struct and the overload of double_pendulum_dots()
+    taking it."""
+    used = set().union(*[e.free_symbols for _, e in constants])
+    contents = '/* S is the scalar type of the integrator. */\n'
+    contents += f'template <typename S>\nstruct {name} {{\n'
+    contents += '    typedef S scalar;\n'
+    if constants:
+        contents += '    S %s;\n' % ', '.join(
+            sym.name for sym, _ in constants)
+    contents += f'    {name}(DoublePendulumParams params) {{\n'
+    for p in PARAMETERS:
+        if p in used:
+            contents += f'        S {p.name} = params.{p.name};\n'
+    constant_printer = KernelPrinter()
+    for sym, expr in constants:
+        contents += f'        {sym.name} = ' \
+                    f'{constant_printer.doprint(expr)};\n'
+    contents += '    }\n};\n'
+    printer = KernelPrinter('k.', 'S(%s)')
+    printer.constant_names = {sym.name for sym, _ in constants}
+    contents += CPP_KERNEL_START.format(name)
+    for sym, expr in statements:
+        declaration = '' if sym.name in OUTPUTS else 'T '
+        contents += f'    {declaration}{sym.name} = ' \
+                    f'{printer.doprint(expr)};\n'
+    contents += '}\n\n'
+    return contents
+
+
+def cpp_preset_dispatch():
+    """The DotsPreset enum and dots_preset(), which picks the most
+    specific preset matching a set of parameters."""
+    enums = ['DOTS_GENERIC=0'] + [e for _, e, _ in PRESETS] \
+        + ['DOTS_PRESET_COUNT']
+    contents = '/* Parameter sets with their own specialized kernel. */\n'
+    contents += 'enum DotsPreset {\n    %s\n};\n\n' % ', '.join(enums)
+    contents += 'inline DotsPreset dots_preset(' \
+                'DoublePendulumParams params) {\n'
+    for _, enum, values in PRESETS:
+        condition = '\n        && '.join(
+            f'params.{p.name} == {float(v)!r}F' for p, v in values.items())
+        contents += f'    if ({condition})\n        return {enum};\n'
+    contents += '    return DOTS_GENERIC;\n}\n\n'
+    return contents
+
+
+def write_cpp(kernels, dst_file_name):
+    contents = CPP_START
+    for name, constants, statements in kernels:
+        contents += cpp_kernel(name, constants, statements)
+    contents += cpp_preset_dispatch()
+    contents += '#endif\n'
+    with open(dst_file_name, 'w') as f:
+        f.write(contents)
+
+
+GLSL_START = """/* Expressions for the time derivatives of each of the coordinates.
+Generated by make_dots_kernels.py from the Hamiltonian of symbolic.ipynb.
+Do not edit. */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D coordinateTex;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+
+"""
+
+GLSL_FUNCTION_START = """vec4 dots(vec4 coord) {
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    float sin1 = sin(phi1), cos1 = cos(phi1);
+    float sin2 = sin(phi2), cos2 = cos(phi2);
+    float s = sin1*cos2 - cos1*sin2;
+    float c = cos1*cos2 + sin1*sin2;
+"""
+
+GLSL_FUNCTION_END = """    return vec4(dot_pi1, dot_pi2, dot_phi1, dot_phi2);
+}
+"""
+
+GLSL_END = """
+void main() {
+    vec4 coord = texture2D(coordinateTex, UV);
+    fragColor = dots(coord);
+}
+"""
+
+
+def glsl_function(constants, statements):
+    """dots(), which expects the uniforms of the pendulum parameters to be
+    declared before it."""
+    printer = KernelPrinter()
+    contents = GLSL_FUNCTION_START
+    for sym, expr in constants + statements:
+        contents += f'    float {sym.name} = {printer.doprint(expr)};\n'
+    return contents + GLSL_FUNCTION_END
+
+
+def write_glsl(constants, statements, dst_file_name):
+    contents = GLSL_START + glsl_function(constants, statements) + GLSL_END
+    with open(dst_file_name, 'w') as f:
+        f.write(contents)
+
+
+def splice_glsl(constants, statements, dst_file_name):
+    with open(dst_file_name) as f:
+        contents = f.read()
+    begin = contents.find(GLSL_GENERATED_BEGIN)
+    end = contents.find(GLSL_GENERATED_END)
+    if begin < 0 or end < begin:
+        print(f'{dst_file_name} has no generated section.')
+        sys.exit(1)
+    begin += len(GLSL_GENERATED_BEGIN)
+    contents = (contents[:begin] + glsl_function(constants, statements)
+                + contents[end:])
+    with open(dst_file_name, 'w') as f:
+        f.write(contents)
+
+
+if __name__ == '__main__':
+    assignments = derive()
+    kernels = []
+    for name, _, values in [('DotsConstants', None, {})] + PRESETS:
+        constants, statements = optimize(
+            [(sym, expr.subs(values)) for sym, expr in assignments])
+        error = check(constants, statements, values)
+        print(f'Generated {name} kernel: {len(constants)} constants, '
+              f'{count_operations(statements)} operations per '
+              f'pendulum, max relative error {error:.3g}.')
+        kernels.append((name, constants, statements))
+    write_cpp(kernels, CPP_FILE_NAME)
+    write_glsl(*kernels[0][1:], GLSL_FILE_NAME)
+    for file_name in GLSL_INTEGRATOR_FILE_NAMES:
+        splice_glsl(*kernels[0][1:], file_name)
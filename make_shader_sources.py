@@ -0,0 +1,61 @@
+"""Generate shader_sources.hpp, which holds the source of every shader in
+shaders/ as a string, so that the program can be started from any working
+directory without the shaders next to it.
+
+Each shader is keyed by the path that the program loads it by, relative
+to the repository root, such as "./shaders/util/copy.frag". The sources
+are written as raw string literals, with a delimiter that no shader
+contains.
+"""
+import os
+
+
+SHADER_DIRECTORY = "shaders"
+SHADER_EXTENSIONS = (".frag", ".vert", ".comp")
+DELIMITER = "SHADER"
+
+HEADER_START = """/* Generated by make_shader_sources.py from the files in shaders/,
+do not edit. */
+#ifndef _SHADER_SOURCES_
+#define _SHADER_SOURCES_
+
+struct EmbeddedShader {
+    const char *path;
+    const char *source;
+};
+
+constexpr EmbeddedShader EMBEDDED_SHADERS[] = {
+"""
+
+HEADER_END = """};
+
+#endif
+"""
+
+
+def shader_paths(directory):
+    paths = []
+    for root, _, files in os.walk(directory):
+        for file_name in files:
+            if file_name.endswith(SHADER_EXTENSIONS):
+                paths.append(os.path.join(root, file_name))
+    return sorted(paths)
+
+
+def write_shader_sources_hpp(directory, dst_file_name):
+    file_contents = HEADER_START
+    for path in shader_paths(directory):
+        with open(path, "r") as f:
+            source = f.read()
+        if f'){DELIMITER}"' in source:
+            raise ValueError(f"{path} contains the raw string delimiter.")
+        key = "./" + path.replace(os.sep, "/")
+        file_contents += \
+            f'    {{"{key}", R"{DELIMITER}({source}){DELIMITER}"}},\n'
+    file_contents += HEADER_END
+    with open(dst_file_name, "w") as f:
+        f.write(file_contents)
+
+
+if __name__ == "__main__":
+    write_shader_sources_hpp(SHADER_DIRECTORY, "shader_sources.hpp")
@@ -7,7 +7,16 @@ namespace sim_2d {
 
 struct SimParams {
     bool useGPU = (bool)(true);
+    bool useComputeShaders = (bool)(false);
+    int cpuThreads = (int)(0);
+    bool pinCPUThreads = (bool)(false);
+    int cpuPrecision = (int)(1);
+    int integrator = (int)(0);
+    int cpuToleranceExponent = (int)(-9);
+    bool flipTime = (bool)(false);
+    int stepScheduling = (int)(1);
     int stepsPerFrame = (int)(10);
+    float frameTime = (float)(16.7F);
     float dt = (float)(0.001F);
     float mass1 = (float)(1.0F);
     float length1 = (float)(1.0F);
@@ -23,33 +32,71 @@ struct SimParams {
     int gridHeight = (int)(128);
     int subGridWidth = (int)(1);
     int subGridHeight = (int)(1);
+    bool probeDensity = (bool)(false);
     enum {
         USE_G_P_U=0,
-        STEPS_PER_FRAME=1,
-        DT=2,
-        MASS1=3,
-        LENGTH1=4,
-        MASS2=5,
-        LENGTH2=6,
-        GRAVITY=7,
-        PENDULUM_DISPLAY_WITH_INITIAL_ANGLES=8,
-        MIN_PHI1=9,
-        MAX_PHI1=10,
-        MIN_PHI2=11,
-        MAX_PHI2=12,
-        GRID_WIDTH=13,
-        GRID_HEIGHT=14,
-        SUB_GRID_WIDTH=15,
-        SUB_GRID_HEIGHT=16,
+        USE_COMPUTE_SHADERS=1,
+        CPU_THREADS=2,
+        PIN_C_P_U_THREADS=3,
+        CPU_PRECISION=4,
+        INTEGRATOR=5,
+        CPU_TOLERANCE_EXPONENT=6,
+        FLIP_TIME=7,
+        STEP_SCHEDULING=8,
+        STEPS_PER_FRAME=9,
+        FRAME_TIME=10,
+        DT=11,
+        MASS1=12,
+        LENGTH1=13,
+        MASS2=14,
+        LENGTH2=15,
+        GRAVITY=16,
+        PENDULUM_DISPLAY_WITH_INITIAL_ANGLES=17,
+        MIN_PHI1=18,
+        MAX_PHI1=19,
+        MIN_PHI2=20,
+        MAX_PHI2=21,
+        GRID_WIDTH=22,
+        GRID_HEIGHT=23,
+        SUB_GRID_WIDTH=24,
+        SUB_GRID_HEIGHT=25,
+        PROBE_DENSITY=26,
     };
     void set(int enum_val, Uniform val) {
         switch(enum_val) {
             case USE_G_P_U:
             useGPU = val.b32;
             break;
+            case USE_COMPUTE_SHADERS:
+            useComputeShaders = val.b32;
+            break;
+            case CPU_THREADS:
+            cpuThreads = val.i32;
+            break;
+            case PIN_C_P_U_THREADS:
+            pinCPUThreads = val.b32;
+            break;
+            case CPU_PRECISION:
+            cpuPrecision = val.i32;
+            break;
+            case INTEGRATOR:
+            integrator = val.i32;
+            break;
+            case CPU_TOLERANCE_EXPONENT:
+            cpuToleranceExponent = val.i32;
+            break;
+            case FLIP_TIME:
+            flipTime = val.b32;
+            break;
+            case STEP_SCHEDULING:
+            stepScheduling = val.i32;
+            break;
             case STEPS_PER_FRAME:
             stepsPerFrame = val.i32;
             break;
+            case FRAME_TIME:
+            frameTime = val.f32;
+            break;
             case DT:
             dt = val.f32;
             break;
@@ -95,14 +142,35 @@ struct SimParams {
             case SUB_GRID_HEIGHT:
             subGridHeight = val.i32;
             break;
+            case PROBE_DENSITY:
+            probeDensity = val.b32;
+            break;
         }
     }
     Uniform get(int enum_val) const {
         switch(enum_val) {
             case USE_G_P_U:
             return {(bool)useGPU};
+            case USE_COMPUTE_SHADERS:
+            return {(bool)useComputeShaders};
+            case CPU_THREADS:
+            return {(int)cpuThreads};
+            case PIN_C_P_U_THREADS:
+            return {(bool)pinCPUThreads};
+            case CPU_PRECISION:
+            return {(int)cpuPrecision};
+            case INTEGRATOR:
+            return {(int)integrator};
+            case CPU_TOLERANCE_EXPONENT:
+            return {(int)cpuToleranceExponent};
+            case FLIP_TIME:
+            return {(bool)flipTime};
+            case STEP_SCHEDULING:
+            return {(int)stepScheduling};
             case STEPS_PER_FRAME:
             return {(int)stepsPerFrame};
+            case FRAME_TIME:
+            return {(float)frameTime};
             case DT:
             return {(float)dt};
             case MASS1:
@@ -133,6 +201,8 @@ struct SimParams {
             return {(int)subGridWidth};
             case SUB_GRID_HEIGHT:
             return {(int)subGridHeight};
+            case PROBE_DENSITY:
+            return {(bool)probeDensity};
         }
         return Uniform(0);
     }
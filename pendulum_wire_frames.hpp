@@ -1,12 +0,0 @@
-#ifndef _PENDULUM_WIRE_FRAMES_
-#define _PENDULUM_WIRE_FRAMES_
-
-#include "gl_wrappers.hpp"
-
-WireFrame get_pendulum_lines_wire_frame(IVec2 d_2d);
-
-WireFrame get_pendulum_points_wire_frame(IVec2 d_2d);
-
-WireFrame get_pendulum_circles_wire_frame(IVec2 d_2d);
-
-#endif
\ No newline at end of file
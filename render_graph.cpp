@@ -0,0 +1,217 @@
+#include "render_graph.hpp"
+#include <stdio.h>
+
+
+RenderGraph::RenderGraph() :
+    m_entries(), m_sequences(), m_spares(),
+    m_counts({.run=0, .skipped=0}) {}
+
+RenderGraph::Resource RenderGraph::add_entry(const Entry &entry) {
+    m_entries.push_back(entry);
+    return Resource(m_entries.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::import(Quad &quad) {
+    return this->add_entry(
+        {.type=Entry::QUAD, .quad=&quad, .render_target=nullptr,
+         .value={.ind{0.0, 0.0, 0.0, 0.0}}, .version=0});
+}
+
+RenderGraph::Resource RenderGraph::import(RenderTarget &render_target) {
+    return this->add_entry(
+        {.type=Entry::RENDER_TARGET, .quad=nullptr,
+         .render_target=&render_target,
+         .value={.ind{0.0, 0.0, 0.0, 0.0}}, .version=0});
+}
+
+RenderGraph::Resource RenderGraph::create_value(Vec4 value) {
+    return this->add_entry(
+        {.type=Entry::VALUE, .quad=nullptr, .render_target=nullptr,
+         .value=value, .version=0});
+}
+
+void RenderGraph::set_value(Resource resource, Vec4 value) {
+    Entry &entry = m_entries[resource];
+    for (int i = 0; i < 4; i++) {
+        if (entry.value[i] != value[i]) {
+            entry.value = value;
+            entry.version++;
+            return;
+        }
+    }
+}
+
+void RenderGraph::touch(Resource resource) {
+    m_entries[resource].version++;
+}
+
+RenderGraph::Sequence RenderGraph::add_sequence() {
+    m_sequences.push_back(std::vector<Pass>());
+    return Sequence(m_sequences.size() - 1);
+}
+
+void RenderGraph::add_pass(
+    Sequence sequence, std::string name,
+    const std::vector<Resource> &inputs,
+    const std::vector<Resource> &outputs,
+    PassFunction function) {
+    Pass pass {
+        .name=name,
+        .inputs=inputs,
+        .outputs=outputs,
+        .swapped=std::vector<bool>(outputs.size(), false),
+        .function=function,
+        .has_run=false,
+        .input_versions=std::vector<size_t>(inputs.size(), 0),
+        .output_versions=std::vector<size_t>(outputs.size(), 0),
+    };
+    for (size_t i = 0; i < outputs.size(); i++) {
+        if (m_entries[outputs[i]].type == Entry::VALUE)
+            fprintf(stderr, "Pass \"%s\" cannot draw to a value.\n",
+                    name.c_str());
+        for (Resource input: inputs)
+            pass.swapped[i] = pass.swapped[i] || input == outputs[i];
+    }
+    m_sequences[sequence].push_back(pass);
+}
+
+/* Whether running the pass again would only draw what is already there.
+Passes that read and write the same resource always change it. */
+bool RenderGraph::is_unchanged(const Pass &pass) const {
+    if (!pass.has_run)
+        return false;
+    for (size_t i = 0; i < pass.inputs.size(); i++) {
+        if (m_entries[pass.inputs[i]].version != pass.input_versions[i])
+            return false;
+    }
+    for (size_t i = 0; i < pass.outputs.size(); i++) {
+        if (pass.swapped[i]
+            || m_entries[pass.outputs[i]].version != pass.output_versions[i])
+            return false;
+    }
+    return true;
+}
+
+RenderGraph::Spare &RenderGraph::acquire_spare(const Entry &entry) {
+    const TextureParams &params = (entry.type == Entry::QUAD)?
+        entry.quad->get_params(): entry.render_target->get_params();
+    for (Spare &spare: m_spares) {
+        if (spare.in_use)
+            continue;
+        if (entry.type == Entry::QUAD && spare.quad
+            && texture_params_equal(spare.quad->get_params(), params)) {
+            spare.in_use = true;
+            return spare;
+        }
+        if (entry.type == Entry::RENDER_TARGET && spare.render_target
+            && texture_params_equal(
+                spare.render_target->get_params(), params)) {
+            spare.in_use = true;
+            return spare;
+        }
+    }
+    Spare spare {};
+    if (entry.type == Entry::QUAD)
+        spare.quad.reset(new Quad(params));
+    else
+        spare.render_target.reset(new RenderTarget(params));
+    spare.in_use = true;
+    m_spares.push_back(std::move(spare));
+    return m_spares.back();
+}
+
+void RenderGraph::replay(Sequence sequence) {
+    for (Pass &pass: m_sequences[sequence]) {
+        if (this->is_unchanged(pass)) {
+            m_counts.skipped++;
+            continue;
+        }
+        // The spares are only looked up by index here, as acquiring one
+        // may move the others.
+        std::vector<size_t> spare_indices;
+        for (size_t i = 0; i < pass.outputs.size(); i++) {
+            if (pass.swapped[i]) {
+                Spare &spare = this->acquire_spare(m_entries[pass.outputs[i]]);
+                spare_indices.push_back(&spare - &m_spares[0]);
+            }
+        }
+        PassContext context(*this, pass);
+        for (size_t index: spare_indices)
+            context.m_spares.push_back(&m_spares[index]);
+        pass.function(context);
+        for (size_t i = 0, j = 0; i < pass.outputs.size(); i++) {
+            Entry &entry = m_entries[pass.outputs[i]];
+            if (pass.swapped[i]) {
+                Spare *spare = context.m_spares[j++];
+                if (entry.type == Entry::QUAD)
+                    entry.quad->swap(*spare->quad);
+                else
+                    entry.render_target->swap(*spare->render_target);
+                spare->in_use = false;
+            }
+            entry.version++;
+            pass.output_versions[i] = entry.version;
+        }
+        for (size_t i = 0; i < pass.inputs.size(); i++)
+            pass.input_versions[i] = m_entries[pass.inputs[i]].version;
+        pass.has_run = true;
+        m_counts.run++;
+    }
+}
+
+void RenderGraph::clear() {
+    m_entries.clear();
+    m_sequences.clear();
+    std::vector<Spare> spares;
+    for (Spare &spare: m_spares) {
+        if (spare.render_target)
+            spares.push_back(std::move(spare));
+    }
+    m_spares = std::move(spares);
+}
+
+RenderGraph::PassCounts RenderGraph::take_pass_counts() {
+    PassCounts counts = m_counts;
+    m_counts = {.run=0, .skipped=0};
+    return counts;
+}
+
+RenderGraph::PassContext::PassContext(RenderGraph &graph, const Pass &pass) :
+    m_graph(graph), m_pass(pass), m_spares() {}
+
+RenderGraph::Spare *RenderGraph::PassContext::spare(
+    Resource resource) const {
+    for (size_t i = 0, j = 0; i < m_pass.outputs.size(); i++) {
+        if (!m_pass.swapped[i])
+            continue;
+        if (m_pass.outputs[i] == resource)
+            return m_spares[j];
+        j++;
+    }
+    return nullptr;
+}
+
+Uniform RenderGraph::PassContext::input(Resource resource) const {
+    const Entry &entry = m_graph.m_entries[resource];
+    if (entry.type == Entry::QUAD)
+        return Uniform((const Quad *)entry.quad);
+    if (entry.type == Entry::RENDER_TARGET)
+        return Uniform((const RenderTarget *)entry.render_target);
+    return Uniform(entry.value);
+}
+
+Vec4 RenderGraph::PassContext::value(Resource resource) const {
+    return m_graph.m_entries[resource].value;
+}
+
+Quad &RenderGraph::PassContext::quad(Resource resource) const {
+    Spare *spare = this->spare(resource);
+    return (spare)? *spare->quad: *m_graph.m_entries[resource].quad;
+}
+
+RenderTarget &RenderGraph::PassContext::render_target(
+    Resource resource) const {
+    Spare *spare = this->spare(resource);
+    return (spare)?
+        *spare->render_target: *m_graph.m_entries[resource].render_target;
+}
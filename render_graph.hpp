@@ -0,0 +1,116 @@
+/* A fixed sequence of passes over Quads and RenderTargets, which is
+recorded once and then replayed on every frame. Each pass declares the
+resources it reads and those it draws to, which lets the graph
+ - skip a pass when nothing that it reads has changed since it last ran, and
+   what it drew then has not been drawn over since,
+ - draw a pass that reads and writes the same resource to a spare texture,
+   and swap the two afterwards, instead of drawing to a temporary texture and
+   copying it back,
+ - share the spare textures between every resource of the same parameters,
+   as each of them is only in use for the length of a single pass.
+For this to hold, everything a pass depends on has to be one of its inputs,
+including any values, such as uniforms, that may change between frames.
+Anything drawn to a resource outside of the graph has to be followed by a
+call to touch.
+*/
+#include "gl_wrappers.hpp"
+#include <functional>
+#include <memory>
+#include <vector>
+
+#ifndef _RENDER_GRAPH_
+#define _RENDER_GRAPH_
+
+class RenderGraph {
+    public:
+    typedef int Resource;
+    typedef int Sequence;
+    class PassContext;
+    typedef std::function<void(PassContext &)> PassFunction;
+    struct PassCounts {
+        size_t run;
+        size_t skipped;
+    };
+    private:
+    struct Entry {
+        enum {QUAD, RENDER_TARGET, VALUE};
+        int type;
+        Quad *quad;
+        RenderTarget *render_target;
+        Vec4 value;
+        // Incremented on every change to the contents.
+        size_t version;
+    };
+    struct Pass {
+        std::string name;
+        std::vector<Resource> inputs;
+        std::vector<Resource> outputs;
+        // Whether each output is also an input, and so drawn to a spare.
+        std::vector<bool> swapped;
+        PassFunction function;
+        // Versions of the inputs and outputs after the pass last ran.
+        bool has_run;
+        std::vector<size_t> input_versions;
+        std::vector<size_t> output_versions;
+    };
+    struct Spare {
+        std::unique_ptr<Quad> quad;
+        std::unique_ptr<RenderTarget> render_target;
+        bool in_use;
+    };
+    std::vector<Entry> m_entries;
+    std::vector<std::vector<Pass>> m_sequences;
+    std::vector<Spare> m_spares;
+    PassCounts m_counts;
+    Resource add_entry(const Entry &entry);
+    bool is_unchanged(const Pass &pass) const;
+    Spare &acquire_spare(const Entry &entry);
+    public:
+    /* What a pass is given when it runs. The textures of the outputs that
+    are also inputs are the spares that are swapped in after the pass, so
+    that they are not the textures read through input. */
+    class PassContext {
+        RenderGraph &m_graph;
+        const Pass &m_pass;
+        std::vector<Spare *> m_spares;
+        PassContext(RenderGraph &graph, const Pass &pass);
+        Spare *spare(Resource resource) const;
+        friend class RenderGraph;
+        public:
+        /* A uniform for the texture or value of an input. */
+        Uniform input(Resource resource) const;
+        Vec4 value(Resource resource) const;
+        Quad &quad(Resource resource) const;
+        RenderTarget &render_target(Resource resource) const;
+    };
+    RenderGraph();
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+    /* Textures owned elsewhere, which keep their contents between
+    replays. Swapping in the spare of a pass exchanges the contents of the
+    given Quad or RenderTarget with those of the spare, so that it always
+    holds the latest contents. */
+    Resource import(Quad &quad);
+    Resource import(RenderTarget &render_target);
+    /* A value that passes may read, which only counts as changed when it
+    is set to something different. */
+    Resource create_value(Vec4 value);
+    void set_value(Resource resource, Vec4 value);
+    /* Mark the contents of a resource as changed outside of the graph. */
+    void touch(Resource resource);
+    Sequence add_sequence();
+    void add_pass(Sequence sequence, std::string name,
+                  const std::vector<Resource> &inputs,
+                  const std::vector<Resource> &outputs,
+                  PassFunction function);
+    /* Run the passes of the sequence in the order they were added. */
+    void replay(Sequence sequence);
+    /* Remove every resource and pass. The spare Quads are freed, while
+    the spare RenderTargets are kept for the next recording, as
+    RenderTargets are never freed. */
+    void clear();
+    /* Passes run and skipped since the last call. */
+    PassCounts take_pass_counts();
+};
+
+#endif
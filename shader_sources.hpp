@@ -0,0 +1,1313 @@
+/* Generated by make_shader_sources.py from the files in shaders/,
+do not edit. */
+#ifndef _SHADER_SOURCES_
+#define _SHADER_SOURCES_
+
+struct EmbeddedShader {
+    const char *path;
+    const char *source;
+};
+
+constexpr EmbeddedShader EMBEDDED_SHADERS[] = {
+    {"./shaders/double-pendulum/circles-display.vert", R"SHADER(/* Draw the bobs of every pendulum in the probed part of the grid as
+circles, with one instance for each pendulum. Each of its two circles is a fan
+of CIRCLE_SEGMENTS triangles, which has to match the vertex count of the
+instances. */
+#if __VERSION__ <= 120
+varying vec2 UV;
+#else
+out vec2 UV;
+#endif
+
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+uniform sampler2D coordTex;
+// Offset and size of the probed part of the grid in texture coordinates
+// of coordTex, and its number of pendulums along each direction.
+uniform vec4 probe;
+uniform ivec2 probeSize;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+uniform float circleRadius;
+uniform float viewScale;
+uniform vec2 viewOffset;
+
+const int CIRCLE_SEGMENTS = 10;
+const float PI = 3.141592653589793;
+
+void main() {
+    ivec2 index = ivec2(gl_InstanceID % probeSize.x,
+                        gl_InstanceID / probeSize.x);
+    UV = probe.xy + probe.zw*(vec2(index) + 0.5)/vec2(probeSize);
+    vec4 coord = texture2D(coordTex, UV);
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    vec2 r0 = length1*vec2(sin(phi1), -cos(phi1));
+    vec2 r1 = length2*vec2(sin(phi2), -cos(phi2));
+    int triangle = gl_VertexID/3;
+    int corner = gl_VertexID - 3*triangle;
+    vec2 r = (triangle < CIRCLE_SEGMENTS)?
+        viewOffset + viewScale*r0: viewOffset + viewScale*(r0 + r1);
+    // The first corner of each triangle is the center of the circle,
+    // and the other two are on its edge.
+    if (corner > 0) {
+        int segment = triangle % CIRCLE_SEGMENTS + corner - 1;
+        float circleAngle = 2.0*PI*float(segment)/float(CIRCLE_SEGMENTS);
+        r += circleRadius*vec2(cos(circleAngle), sin(circleAngle));
+    }
+    gl_Position = vec4(r, 0.0, 1.0);
+
+}
+)SHADER"},
+    {"./shaders/double-pendulum/color.frag", R"SHADER(/* Colour the double pendulum based on its angular separations */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D coordFragTex;
+
+const float PI = 3.141592653589793;
+
+vec3 argumentToColor(float argVal) {
+    float maxCol = 1.0;
+    float minCol = 50.0/255.0;
+    float colRange = maxCol - minCol;
+    if (argVal <= PI/3.0 && argVal >= 0.0) {
+        return vec3(maxCol,
+                    minCol + colRange*argVal/(PI/3.0), minCol);
+    } else if (argVal > PI/3.0 && argVal <= 2.0*PI/3.0){
+        return vec3(maxCol - colRange*(argVal - PI/3.0)/(PI/3.0),
+                    maxCol, minCol);
+    } else if (argVal > 2.0*PI/3.0 && argVal <= PI){
+        return vec3(minCol, maxCol,
+                    minCol + colRange*(argVal - 2.0*PI/3.0)/(PI/3.0));
+    } else if (argVal > PI && argVal <= 4.0*PI/3.0){
+        return vec3(minCol,
+                    maxCol - (colRange*(argVal - PI)/(PI/3.0)), 
+                    maxCol);
+    } else if (argVal > 4.0*PI/3.0 && argVal <= 5.0*PI/3.0) {
+        return vec3(minCol + (colRange*(argVal - 4.0*PI/3.0)/(PI/3.0)),
+                    minCol, maxCol);
+    } else if (argVal > 5.0*PI/3.0 && argVal < 2.0*PI){
+        return vec3(maxCol, minCol,
+                    maxCol - colRange*(argVal - 5.0*PI/3.0)/(PI/3.0));
+    } else {
+        return vec3(minCol, maxCol, maxCol);
+    }
+}
+
+float modAngle0To2Pi(float phi) {
+    return (phi < 0.0)? (2.0*PI - mod(-phi, 2.0*PI)): mod(phi, 2.0*PI);
+}
+
+
+void main() {
+    vec4 coord = texture2D(coordFragTex, UV);
+    float phi1 = coord[2], phi2 = coord[3];
+    float phi12 = modAngle0To2Pi(phi1 + phi2);
+    vec3 color = argumentToColor(phi12);
+    fragColor = vec4(color, 0.5);
+})SHADER"},
+    {"./shaders/double-pendulum/density-color.frag", R"SHADER(/* Colour the density of the bobs of the probed pendulums, given as the
+number of bobs that landed on each texel of densityTex, on a logarithmic
+scale going from black through red and yellow to white. */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D densityTex;
+
+// Half floats only count every bob up to this many, so denser texels get
+// the last colour.
+const float MAX_DENSITY = 2048.0;
+
+void main() {
+    float density = texture2D(densityTex, UV)[0];
+    float x = min(log(1.0 + density)/log(1.0 + MAX_DENSITY), 1.0);
+    fragColor = vec4(clamp(3.0*x, 0.0, 1.0),
+                     clamp(3.0*x - 1.0, 0.0, 1.0),
+                     clamp(3.0*x - 2.0, 0.0, 1.0), 1.0);
+}
+)SHADER"},
+    {"./shaders/double-pendulum/dots.frag", R"SHADER(/* Expressions for the time derivatives of each of the coordinates.
+Generated by make_dots_kernels.py from the Hamiltonian of symbolic.ipynb.
+Do not edit. */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D coordinateTex;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+
+vec4 dots(vec4 coord) {
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    float sin1 = sin(phi1), cos1 = cos(phi1);
+    float sin2 = sin(phi2), cos2 = cos(phi2);
+    float s = sin1*cos2 - cos1*sin2;
+    float c = cos1*cos2 + sin1*sin2;
+    float k0 = length1*length2*mass2;
+    float k1 = -mass1 - mass2;
+    float k2 = -1.0/length1;
+    float k3 = -(mass1 + mass2)/(length2*mass2);
+    float k4 = -length1*length1*length2*length2*mass2*mass2;
+    float k5 = -length1*length2*mass2*(mass1 + mass2)*(length1 + length2 - 3.0);
+    float k6 = length1*length1*length2*mass2*(length1 - 1.0)*(mass1 + mass2);
+    float k7 = length1*length2*length2*mass2*mass2*(length2 - 1.0);
+    float k8 = -gravity*length1*(mass1 + mass2);
+    float k9 = -gravity*length2*mass2;
+    float inv_d = 1.0/(c*c*k0 + k1);
+    float dot_phi1 = inv_d*(c*pi2 + k2*pi1);
+    float dot_phi2 = inv_d*(c*pi1 + k3*pi2);
+    float dh_dc = inv_d*(c*dot_phi1*dot_phi1*k6 + c*dot_phi2*dot_phi2*k7 + dot_phi1*dot_phi2*(c*c*k4 + k5));
+    float dot_pi1 = dh_dc*s + k8*sin1;
+    float dot_pi2 = -dh_dc*s + k9*sin2;
+    return vec4(dot_pi1, dot_pi2, dot_phi1, dot_phi2);
+}
+
+void main() {
+    vec4 coord = texture2D(coordinateTex, UV);
+    fragColor = dots(coord);
+}
+)SHADER"},
+    {"./shaders/double-pendulum/energy.frag", R"SHADER(/* Compute the energy of each of the double pendulums. */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D coordTex;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+
+/* Time derivative of the angular positions phi1 and phi2. */
+float dotPhi(int i, vec4 coord) {
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    float m11 = (mass1 + mass2)*length1;
+    float m12 = mass2*length1*length2*cos(phi1 - phi2);
+    float m21 = mass2*length1*length2*cos(phi1 - phi2);
+    float m22 = mass2*length2;
+    if (i == 1)
+        return -m22*pi1/(m12*m21 - m22*m11) + m12*pi2/(m12*m21 - m22*m11);
+    else if (i == 2)
+        return m21*pi1/(m12*m21 - m22*m11) - m11*pi2/(m12*m21 - m22*m11);
+}
+
+float dotPhi1(vec4 coord) {
+    return dotPhi(1, coord);
+}
+
+float dotPhi2(vec4 coord) {
+    return dotPhi(2, coord);
+}
+
+float lagrangian(vec4 coord) {
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    return (
+        0.5*(mass1 + mass2)*pow(length1*dotPhi1(coord), 2.0)
+        + 0.5*mass2*pow(length2*dotPhi2(coord), 2.0)
+        + mass2*length1*length2
+            *dotPhi1(coord)*dotPhi2(coord)*cos(phi1 - phi2)
+        + (mass1 + mass2)*gravity*length1*cos(phi1)
+        + mass2*gravity*length2*cos(phi2));
+}
+
+float hamiltonian(vec4 coord) {
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    return dotPhi1(coord)*pi1 + dotPhi2(coord)*pi2 - lagrangian(coord);
+}
+
+void main() {
+    vec4 coord = texture2D(coordTex, UV);
+    float energy = hamiltonian(coord);
+    fragColor = vec4(energy/10.0, 0.0, -energy/10.0, 1.0);
+}
+)SHADER"},
+    {"./shaders/double-pendulum/flip-time-color.frag", R"SHADER(/* Colour each pendulum by the time until either of its arms first flips,
+on a logarithmic scale in units of timeUnit, going from red for the
+quickest flips through the hues to magenta. Those that have not flipped
+are left black. */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D flipTimeTex;
+uniform float timeUnit;
+
+const float PI = 3.141592653589793;
+// Flips that take longer than this many time units get the last colour.
+const float MAX_TIME = 1000.0;
+
+vec3 argumentToColor(float argVal) {
+    float maxCol = 1.0;
+    float minCol = 50.0/255.0;
+    float colRange = maxCol - minCol;
+    if (argVal <= PI/3.0 && argVal >= 0.0) {
+        return vec3(maxCol,
+                    minCol + colRange*argVal/(PI/3.0), minCol);
+    } else if (argVal > PI/3.0 && argVal <= 2.0*PI/3.0){
+        return vec3(maxCol - colRange*(argVal - PI/3.0)/(PI/3.0),
+                    maxCol, minCol);
+    } else if (argVal > 2.0*PI/3.0 && argVal <= PI){
+        return vec3(minCol, maxCol,
+                    minCol + colRange*(argVal - 2.0*PI/3.0)/(PI/3.0));
+    } else if (argVal > PI && argVal <= 4.0*PI/3.0){
+        return vec3(minCol,
+                    maxCol - (colRange*(argVal - PI)/(PI/3.0)), 
+                    maxCol);
+    } else if (argVal > 4.0*PI/3.0 && argVal <= 5.0*PI/3.0) {
+        return vec3(minCol + (colRange*(argVal - 4.0*PI/3.0)/(PI/3.0)),
+                    minCol, maxCol);
+    } else if (argVal > 5.0*PI/3.0 && argVal < 2.0*PI){
+        return vec3(maxCol, minCol,
+                    maxCol - colRange*(argVal - 5.0*PI/3.0)/(PI/3.0));
+    } else {
+        return vec3(minCol, maxCol, maxCol);
+    }
+}
+
+void main() {
+    float flipTime = texture2D(flipTimeTex, UV)[0];
+    if (flipTime <= 0.0) {
+        fragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    float x = log(1.0 + flipTime/timeUnit)/log(1.0 + MAX_TIME);
+    fragColor = vec4(argumentToColor(5.0*PI/3.0*min(x, 1.0)), 1.0);
+}
+)SHADER"},
+    {"./shaders/double-pendulum/flip-time.frag", R"SHADER(/* Record the time at which either arm of each pendulum first goes over
+the top, where a time of zero means that it has not flipped yet. */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D coordTex;
+uniform sampler2D flipTimeTex;
+uniform float time;
+
+const float PI = 3.141592653589793;
+
+void main() {
+    vec4 coord = texture2D(coordTex, UV);
+    float phi1 = coord[2], phi2 = coord[3];
+    float flipTime = texture2D(flipTimeTex, UV)[0];
+    if (flipTime == 0.0 && (abs(phi1) > PI || abs(phi2) > PI))
+        flipTime = time;
+    fragColor = vec4(flipTime, 0.0, 0.0, 1.0);
+}
+)SHADER"},
+    {"./shaders/double-pendulum/init.comp", R"SHADER(/* Initial coordinates of every pendulum of the grid for the compute shader
+backend, as in init.frag, with the flip times cleared. The angles are those
+at the centres of the texels of a texture of the size of the grid, which
+the grid need not fit in. */
+#ifdef GL_ES
+precision highp float;
+#endif
+
+layout(local_size_x=8, local_size_y=8) in;
+
+layout(std430, binding=0) buffer Coords {
+    vec4 coords[];
+};
+
+layout(std430, binding=1) buffer FlipTimes {
+    float flipTimes[];
+};
+
+uniform int width;
+uniform int height;
+uniform float minPhi1;
+uniform float maxPhi1;
+uniform float minPhi2;
+uniform float maxPhi2;
+
+void main() {
+    int x = int(gl_GlobalInvocationID.x), y = int(gl_GlobalInvocationID.y);
+    if (x >= width || y >= height)
+        return;
+    vec2 uv = (vec2(x, y) + 0.5)/vec2(width, height);
+    float phi1 = minPhi1 + uv.x*(maxPhi1 - minPhi1);
+    float phi2 = minPhi2 + uv.y*(maxPhi2 - minPhi2);
+    coords[y*width + x] = vec4(0.0, 0.0, phi1, phi2);
+    flipTimes[y*width + x] = 0.0;
+}
+)SHADER"},
+    {"./shaders/double-pendulum/init.frag", R"SHADER(#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+const float PI = 3.141592653589793;
+uniform float minPhi1;
+uniform float maxPhi1;
+uniform float minPhi2;
+uniform float maxPhi2;
+
+void main() {
+    // Initial conjugate momenta
+    float pi1 = 0.0;
+    float pi2 = 0.0;
+    // Initial angular separations
+    float phi1 = minPhi1 + UV.x*(maxPhi1 - minPhi1);
+    float phi2 = minPhi2 + UV.y*(maxPhi2 - minPhi2);
+    fragColor = vec4(pi1, pi2, phi1, phi2);
+})SHADER"},
+    {"./shaders/double-pendulum/lines-display.vert", R"SHADER(/* Draw the arms of every pendulum in the probed part of the grid, with one
+instance for each pendulum made of two line segments, whose ends are given by
+gl_VertexID. */
+#if __VERSION__ <= 120
+varying vec2 UV;
+#else
+out vec2 UV;
+#endif
+
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+uniform sampler2D coordTex;
+// Offset and size of the probed part of the grid in texture coordinates
+// of coordTex, and its number of pendulums along each direction.
+uniform vec4 probe;
+uniform ivec2 probeSize;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+uniform float viewScale;
+uniform vec2 viewOffset;
+
+void main() {
+    ivec2 index = ivec2(gl_InstanceID % probeSize.x,
+                        gl_InstanceID / probeSize.x);
+    UV = probe.xy + probe.zw*(vec2(index) + 0.5)/vec2(probeSize);
+    vec4 coord = texture2D(coordTex, UV);
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    vec2 r0 = length1*vec2(sin(phi1), -cos(phi1));
+    vec2 r1 = length2*vec2(sin(phi2), -cos(phi2));
+    vec2 r;
+    if (gl_VertexID == 0)
+        r = viewOffset;
+    else if (gl_VertexID == 1 || gl_VertexID == 2)
+        r = viewOffset + viewScale*r0;
+    else
+        r = viewOffset + viewScale*(r0 + r1);
+    gl_Position = vec4(r, 0.0, 1.0);
+
+}
+)SHADER"},
+    {"./shaders/double-pendulum/points-display.vert", R"SHADER(/* Draw the bobs of every pendulum in the probed part of the grid as points,
+with one instance of two vertices for each pendulum. */
+#if __VERSION__ <= 120
+varying vec2 UV;
+#else
+out vec2 UV;
+#endif
+
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+uniform sampler2D coordTex;
+// Offset and size of the probed part of the grid in texture coordinates
+// of coordTex, and its number of pendulums along each direction.
+uniform vec4 probe;
+uniform ivec2 probeSize;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+uniform float viewScale;
+uniform vec2 viewOffset;
+uniform float pointSize;
+
+void main() {
+    ivec2 index = ivec2(gl_InstanceID % probeSize.x,
+                        gl_InstanceID / probeSize.x);
+    UV = probe.xy + probe.zw*(vec2(index) + 0.5)/vec2(probeSize);
+    vec4 coord = texture2D(coordTex, UV);
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    vec2 r0 = length1*vec2(sin(phi1), -cos(phi1));
+    vec2 r1 = length2*vec2(sin(phi2), -cos(phi2));
+    vec2 r;
+    if (gl_VertexID == 0)
+        r = viewOffset + viewScale*r0;
+    else
+        r = viewOffset + viewScale*(r0 + r1);
+    gl_Position = vec4(r, 0.0, 1.0);
+    gl_PointSize = pointSize;
+
+}
+)SHADER"},
+    {"./shaders/double-pendulum/sample.comp", R"SHADER(/* Pick out the pendulums that are shown from the storage buffers of the
+compute shader backend, so that only they are copied to textures and the
+grid itself can be larger than any texture:
+ - for every texel of the display textures, the pendulum nearest to its
+   centre, for the views of the whole grid,
+ - every pendulum of the probed part of the grid, as sampled by the probe
+   views from a texture of the whole grid.
+The work groups cover whichever of the two is larger.
+*/
+#ifdef GL_ES
+precision highp float;
+#endif
+
+layout(local_size_x=8, local_size_y=8) in;
+
+layout(std430, binding=0) buffer Coords {
+    vec4 coords[];
+};
+
+layout(std430, binding=1) buffer FlipTimes {
+    float flipTimes[];
+};
+
+layout(std430, binding=2) buffer DisplayCoords {
+    vec4 displayCoords[];
+};
+
+layout(std430, binding=3) buffer DisplayFlipTimes {
+    float displayFlipTimes[];
+};
+
+layout(std430, binding=4) buffer ProbeCoords {
+    vec4 probeCoords[];
+};
+
+uniform ivec2 gridSize;
+uniform ivec2 displaySize;
+// Offset and size of the probed part of the grid in texture coordinates
+// of the grid, and its number of pendulums along each direction.
+uniform vec4 probe;
+uniform ivec2 probeSize;
+
+int gridIndex(vec2 uv) {
+    ivec2 position = clamp(ivec2(uv*vec2(gridSize)), ivec2(0), gridSize - 1);
+    return position.y*gridSize.x + position.x;
+}
+
+void main() {
+    ivec2 index = ivec2(gl_GlobalInvocationID.xy);
+    if (all(lessThan(index, displaySize))) {
+        int i = gridIndex((vec2(index) + 0.5)/vec2(displaySize));
+        displayCoords[index.y*displaySize.x + index.x] = coords[i];
+        displayFlipTimes[index.y*displaySize.x + index.x] = flipTimes[i];
+    }
+    if (all(lessThan(index, probeSize))) {
+        int i = gridIndex(
+            probe.xy + probe.zw*(vec2(index) + 0.5)/vec2(probeSize));
+        probeCoords[index.y*probeSize.x + index.x] = coords[i];
+    }
+}
+)SHADER"},
+    {"./shaders/integration/extended-phase-space.frag", R"SHADER(/* Steps of Tao's explicit symplectic method for non-separable
+Hamiltonians. The pendulum is split into two copies bound together by a term
+of strength omega, and the flows of H(phi, pi_e), H(phi_e, pi) and of the
+binding term are composed into the Strang splitting
+A(h/2) B(h/2) C(h) B(h/2) A(h/2), then into a fourth order method by the
+triple jump of Yoshida. The copies are averaged at the end of every step, as
+in cpu_integration.cpp, and a single pass takes as many steps as given by
+the steps uniform.
+
+References:
+    Molei Tao, Explicit symplectic approximation of nonseparable
+    Hamiltonians: algorithm and long time performance, Phys. Rev. E 94,
+    043303 (2016).
+
+    Pauli Pihajoki, Explicit methods in extended phase space for
+    inseparable Hamiltonian problems, Celest. Mech. Dyn. Astr. 121,
+    211-231 (2015).
+*/
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D qTex;
+uniform float dt;
+uniform int steps;
+uniform float omega;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+
+// GENERATED_BEGIN by make_dots_kernels.py
+vec4 dots(vec4 coord) {
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    float sin1 = sin(phi1), cos1 = cos(phi1);
+    float sin2 = sin(phi2), cos2 = cos(phi2);
+    float s = sin1*cos2 - cos1*sin2;
+    float c = cos1*cos2 + sin1*sin2;
+    float k0 = length1*length2*mass2;
+    float k1 = -mass1 - mass2;
+    float k2 = -1.0/length1;
+    float k3 = -(mass1 + mass2)/(length2*mass2);
+    float k4 = -length1*length1*length2*length2*mass2*mass2;
+    float k5 = -length1*length2*mass2*(mass1 + mass2)*(length1 + length2 - 3.0);
+    float k6 = length1*length1*length2*mass2*(length1 - 1.0)*(mass1 + mass2);
+    float k7 = length1*length2*length2*mass2*mass2*(length2 - 1.0);
+    float k8 = -gravity*length1*(mass1 + mass2);
+    float k9 = -gravity*length2*mass2;
+    float inv_d = 1.0/(c*c*k0 + k1);
+    float dot_phi1 = inv_d*(c*pi2 + k2*pi1);
+    float dot_phi2 = inv_d*(c*pi1 + k3*pi2);
+    float dh_dc = inv_d*(c*dot_phi1*dot_phi1*k6 + c*dot_phi2*dot_phi2*k7 + dot_phi1*dot_phi2*(c*c*k4 + k5));
+    float dot_pi1 = dh_dc*s + k8*sin1;
+    float dot_pi2 = -dh_dc*s + k9*sin2;
+    return vec4(dot_pi1, dot_pi2, dot_phi1, dot_phi2);
+}
+// GENERATED_END
+
+const float GAMMA1 = 1.3512071919596578;
+const float GAMMA2 = -1.7024143839193155;
+
+vec4 q, e;
+
+void flowA(float d) {
+    vec4 f = dots(vec4(e.xy, q.zw));
+    q.xy += d*f.xy;
+    e.zw += d*f.zw;
+}
+
+void flowB(float d) {
+    vec4 f = dots(vec4(q.xy, e.zw));
+    q.zw += d*f.zw;
+    e.xy += d*f.xy;
+}
+
+/* Rotates the difference between the two copies while keeping their sum
+fixed. */
+void flowC(float d) {
+    float c = cos(2.0*omega*d), s = sin(2.0*omega*d);
+    vec4 sum = q + e, diff = q - e;
+    vec4 rotated = vec4(c*diff.xy - s*diff.zw, c*diff.zw + s*diff.xy);
+    q = 0.5*(sum + rotated);
+    e = 0.5*(sum - rotated);
+}
+
+// Loops need a constant bound in older versions of GLSL.
+#define MAX_STEPS 32
+
+void main() {
+    q = texture2D(qTex, UV);
+    for (int i = 0; i < MAX_STEPS; i++) {
+        if (i >= steps)
+            break;
+        e = q;
+        flowA(0.5*GAMMA1*dt);
+        flowB(0.5*GAMMA1*dt);
+        flowC(GAMMA1*dt);
+        flowB(0.5*GAMMA1*dt);
+        flowA(0.5*(GAMMA1 + GAMMA2)*dt);
+        flowB(0.5*GAMMA2*dt);
+        flowC(GAMMA2*dt);
+        flowB(0.5*GAMMA2*dt);
+        flowA(0.5*(GAMMA1 + GAMMA2)*dt);
+        flowB(0.5*GAMMA1*dt);
+        flowC(GAMMA1*dt);
+        flowB(0.5*GAMMA1*dt);
+        flowA(0.5*GAMMA1*dt);
+        q = 0.5*(q + e);
+    }
+    fragColor = q;
+}
+)SHADER"},
+    {"./shaders/integration/forward-euler.frag", R"SHADER(#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D qTex;
+uniform sampler2D qDotTex;
+uniform float dt;
+uniform vec4 weights;
+
+void main() {
+    vec4 q = texture2D(qTex, UV);
+    vec4 qDot = texture2D(qDotTex, UV); 
+    fragColor = q + dt*weights*qDot;
+})SHADER"},
+    {"./shaders/integration/gauss-legendre.frag", R"SHADER(/* Steps of the two stage Gauss-Legendre method, which is implicit,
+symplectic and of fourth order. Its stages are found by fixed point
+iteration, which converges as long as dt is small compared to the time scale
+of the motion. A single pass takes as many steps as given by the steps
+uniform.
+
+Reference:
+    Hairer, Lubich and Wanner, Geometric Numerical Integration,
+    chapter II.1.3 (Gauss collocation methods).
+*/
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D qTex;
+uniform float dt;
+uniform int steps;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+
+// GENERATED_BEGIN by make_dots_kernels.py
+vec4 dots(vec4 coord) {
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    float sin1 = sin(phi1), cos1 = cos(phi1);
+    float sin2 = sin(phi2), cos2 = cos(phi2);
+    float s = sin1*cos2 - cos1*sin2;
+    float c = cos1*cos2 + sin1*sin2;
+    float k0 = length1*length2*mass2;
+    float k1 = -mass1 - mass2;
+    float k2 = -1.0/length1;
+    float k3 = -(mass1 + mass2)/(length2*mass2);
+    float k4 = -length1*length1*length2*length2*mass2*mass2;
+    float k5 = -length1*length2*mass2*(mass1 + mass2)*(length1 + length2 - 3.0);
+    float k6 = length1*length1*length2*mass2*(length1 - 1.0)*(mass1 + mass2);
+    float k7 = length1*length2*length2*mass2*mass2*(length2 - 1.0);
+    float k8 = -gravity*length1*(mass1 + mass2);
+    float k9 = -gravity*length2*mass2;
+    float inv_d = 1.0/(c*c*k0 + k1);
+    float dot_phi1 = inv_d*(c*pi2 + k2*pi1);
+    float dot_phi2 = inv_d*(c*pi1 + k3*pi2);
+    float dh_dc = inv_d*(c*dot_phi1*dot_phi1*k6 + c*dot_phi2*dot_phi2*k7 + dot_phi1*dot_phi2*(c*c*k4 + k5));
+    float dot_pi1 = dh_dc*s + k8*sin1;
+    float dot_pi2 = -dh_dc*s + k9*sin2;
+    return vec4(dot_pi1, dot_pi2, dot_phi1, dot_phi2);
+}
+// GENERATED_END
+
+#define MAX_ITERATIONS 12
+// Loops need a constant bound in older versions of GLSL.
+#define MAX_STEPS 32
+
+const float A11 = 0.25, A12 = 0.25 - 0.28867513;
+const float A21 = 0.25 + 0.28867513, A22 = 0.25;
+
+void main() {
+    vec4 q = texture2D(qTex, UV);
+    vec4 k1 = dots(q), k2 = k1;
+    for (int n = 0; n < MAX_STEPS; n++) {
+        if (n >= steps)
+            break;
+        vec4 scale = 4.0e-7*(1.0 + abs(q));
+        for (int i = 0; i < MAX_ITERATIONS; i++) {
+            vec4 nextK1 = dots(q + dt*(A11*k1 + A12*k2));
+            vec4 nextK2 = dots(q + dt*(A21*k1 + A22*k2));
+            vec4 change = abs(dt)*(abs(nextK1 - k1) + abs(nextK2 - k2));
+            k1 = nextK1;
+            k2 = nextK2;
+            if (all(lessThanEqual(change, scale)))
+                break;
+        }
+        q += 0.5*dt*(k1 + k2);
+    }
+    fragColor = q;
+}
+)SHADER"},
+    {"./shaders/integration/integrate.comp", R"SHADER(/* Steps of the double pendulum for the compute shader backend. The
+coordinates are read from and written back to a storage buffer, with one
+invocation for each pendulum, and a single dispatch takes the pendulums
+through as many steps as given by the steps uniform with the method given by
+the integrator uniform. The methods are the same as those of the fragment
+shaders in this directory.
+
+If recordFlips is set, the time at which either arm of each pendulum first
+goes over the top is recorded after every step, as in flip-time.frag, and a
+pendulum that has flipped is not integrated any further.
+*/
+#ifdef GL_ES
+precision highp float;
+#endif
+
+layout(local_size_x=8, local_size_y=8) in;
+
+layout(std430, binding=0) buffer Coords {
+    vec4 coords[];
+};
+
+layout(std430, binding=1) buffer FlipTimes {
+    float flipTimes[];
+};
+
+uniform int width;
+uniform int height;
+// The integrator and recordFlips may instead be defined as constants.
+#ifndef integrator
+uniform int integrator;
+#endif
+uniform float dt;
+uniform int steps;
+uniform float omega;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+#ifndef recordFlips
+uniform int recordFlips;
+#endif
+uniform float time;
+
+// GENERATED_BEGIN by make_dots_kernels.py
+vec4 dots(vec4 coord) {
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    float sin1 = sin(phi1), cos1 = cos(phi1);
+    float sin2 = sin(phi2), cos2 = cos(phi2);
+    float s = sin1*cos2 - cos1*sin2;
+    float c = cos1*cos2 + sin1*sin2;
+    float k0 = length1*length2*mass2;
+    float k1 = -mass1 - mass2;
+    float k2 = -1.0/length1;
+    float k3 = -(mass1 + mass2)/(length2*mass2);
+    float k4 = -length1*length1*length2*length2*mass2*mass2;
+    float k5 = -length1*length2*mass2*(mass1 + mass2)*(length1 + length2 - 3.0);
+    float k6 = length1*length1*length2*mass2*(length1 - 1.0)*(mass1 + mass2);
+    float k7 = length1*length2*length2*mass2*mass2*(length2 - 1.0);
+    float k8 = -gravity*length1*(mass1 + mass2);
+    float k9 = -gravity*length2*mass2;
+    float inv_d = 1.0/(c*c*k0 + k1);
+    float dot_phi1 = inv_d*(c*pi2 + k2*pi1);
+    float dot_phi2 = inv_d*(c*pi1 + k3*pi2);
+    float dh_dc = inv_d*(c*dot_phi1*dot_phi1*k6 + c*dot_phi2*dot_phi2*k7 + dot_phi1*dot_phi2*(c*c*k4 + k5));
+    float dot_pi1 = dh_dc*s + k8*sin1;
+    float dot_pi2 = -dh_dc*s + k9*sin2;
+    return vec4(dot_pi1, dot_pi2, dot_phi1, dot_phi2);
+}
+// GENERATED_END
+
+#define INTEGRATOR_GAUSS_LEGENDRE 1
+#define INTEGRATOR_EXTENDED_PHASE_SPACE 2
+
+const float PI = 3.141592653589793;
+
+vec4 rk4Step(vec4 q) {
+    vec4 qDot1 = dots(q);
+    vec4 qDot2 = dots(q + 0.5*dt*qDot1);
+    vec4 qDot3 = dots(q + 0.5*dt*qDot2);
+    vec4 qDot4 = dots(q + dt*qDot3);
+    return q + dt*(qDot1 + 2.0*qDot2 + 2.0*qDot3 + qDot4)/6.0;
+}
+
+#define MAX_ITERATIONS 12
+
+const float A11 = 0.25, A12 = 0.25 - 0.28867513;
+const float A21 = 0.25 + 0.28867513, A22 = 0.25;
+
+/* The stages k1 and k2 are carried over from the last step as the first
+guess of the next. */
+vec4 gaussLegendreStep(vec4 q, inout vec4 k1, inout vec4 k2) {
+    vec4 scale = 4.0e-7*(1.0 + abs(q));
+    for (int i = 0; i < MAX_ITERATIONS; i++) {
+        vec4 nextK1 = dots(q + dt*(A11*k1 + A12*k2));
+        vec4 nextK2 = dots(q + dt*(A21*k1 + A22*k2));
+        vec4 change = abs(dt)*(abs(nextK1 - k1) + abs(nextK2 - k2));
+        k1 = nextK1;
+        k2 = nextK2;
+        if (all(lessThanEqual(change, scale)))
+            break;
+    }
+    return q + 0.5*dt*(k1 + k2);
+}
+
+const float GAMMA1 = 1.3512071919596578;
+const float GAMMA2 = -1.7024143839193155;
+
+vec4 q, e;
+
+void flowA(float d) {
+    vec4 f = dots(vec4(e.xy, q.zw));
+    q.xy += d*f.xy;
+    e.zw += d*f.zw;
+}
+
+void flowB(float d) {
+    vec4 f = dots(vec4(q.xy, e.zw));
+    q.zw += d*f.zw;
+    e.xy += d*f.xy;
+}
+
+void flowC(float d) {
+    float c = cos(2.0*omega*d), s = sin(2.0*omega*d);
+    vec4 sum = q + e, diff = q - e;
+    vec4 rotated = vec4(c*diff.xy - s*diff.zw, c*diff.zw + s*diff.xy);
+    q = 0.5*(sum + rotated);
+    e = 0.5*(sum - rotated);
+}
+
+void extendedPhaseSpaceStep() {
+    e = q;
+    flowA(0.5*GAMMA1*dt);
+    flowB(0.5*GAMMA1*dt);
+    flowC(GAMMA1*dt);
+    flowB(0.5*GAMMA1*dt);
+    flowA(0.5*(GAMMA1 + GAMMA2)*dt);
+    flowB(0.5*GAMMA2*dt);
+    flowC(GAMMA2*dt);
+    flowB(0.5*GAMMA2*dt);
+    flowA(0.5*(GAMMA1 + GAMMA2)*dt);
+    flowB(0.5*GAMMA1*dt);
+    flowC(GAMMA1*dt);
+    flowB(0.5*GAMMA1*dt);
+    flowA(0.5*GAMMA1*dt);
+    q = 0.5*(q + e);
+}
+
+void main() {
+    int x = int(gl_GlobalInvocationID.x), y = int(gl_GlobalInvocationID.y);
+    if (x >= width || y >= height)
+        return;
+    int index = y*width + x;
+    float flipTime = (recordFlips != 0)? flipTimes[index]: 0.0;
+    if (flipTime != 0.0)
+        return;
+    q = coords[index];
+    vec4 k1 = dots(q), k2 = k1;
+    for (int n = 0; n < steps; n++) {
+        if (integrator == INTEGRATOR_GAUSS_LEGENDRE)
+            q = gaussLegendreStep(q, k1, k2);
+        else if (integrator == INTEGRATOR_EXTENDED_PHASE_SPACE)
+            extendedPhaseSpaceStep();
+        else
+            q = rk4Step(q);
+        if (recordFlips != 0 && (abs(q[2]) > PI || abs(q[3]) > PI)) {
+            flipTime = time + float(n + 1)*abs(dt);
+            break;
+        }
+    }
+    coords[index] = q;
+    if (flipTime != 0.0)
+        flipTimes[index] = flipTime;
+}
+)SHADER"},
+    {"./shaders/integration/rk4.frag", R"SHADER(/* RK4 steps of the double pendulum, with the four stages of every step
+computed in registers, so that a single pass takes the pendulums through
+as many steps as given by the steps uniform.
+
+Reference:
+    Wikipedia - Runge–Kutta methods
+    https://en.wikipedia.org/wiki/Runge%E2%80%93Kutta_methods
+*/
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D qTex;
+uniform float dt;
+uniform int steps;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+
+// GENERATED_BEGIN by make_dots_kernels.py
+vec4 dots(vec4 coord) {
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    float sin1 = sin(phi1), cos1 = cos(phi1);
+    float sin2 = sin(phi2), cos2 = cos(phi2);
+    float s = sin1*cos2 - cos1*sin2;
+    float c = cos1*cos2 + sin1*sin2;
+    float k0 = length1*length2*mass2;
+    float k1 = -mass1 - mass2;
+    float k2 = -1.0/length1;
+    float k3 = -(mass1 + mass2)/(length2*mass2);
+    float k4 = -length1*length1*length2*length2*mass2*mass2;
+    float k5 = -length1*length2*mass2*(mass1 + mass2)*(length1 + length2 - 3.0);
+    float k6 = length1*length1*length2*mass2*(length1 - 1.0)*(mass1 + mass2);
+    float k7 = length1*length2*length2*mass2*mass2*(length2 - 1.0);
+    float k8 = -gravity*length1*(mass1 + mass2);
+    float k9 = -gravity*length2*mass2;
+    float inv_d = 1.0/(c*c*k0 + k1);
+    float dot_phi1 = inv_d*(c*pi2 + k2*pi1);
+    float dot_phi2 = inv_d*(c*pi1 + k3*pi2);
+    float dh_dc = inv_d*(c*dot_phi1*dot_phi1*k6 + c*dot_phi2*dot_phi2*k7 + dot_phi1*dot_phi2*(c*c*k4 + k5));
+    float dot_pi1 = dh_dc*s + k8*sin1;
+    float dot_pi2 = -dh_dc*s + k9*sin2;
+    return vec4(dot_pi1, dot_pi2, dot_phi1, dot_phi2);
+}
+// GENERATED_END
+
+// Loops need a constant bound in older versions of GLSL.
+#define MAX_STEPS 32
+
+void main() {
+    vec4 q = texture2D(qTex, UV);
+    for (int i = 0; i < MAX_STEPS; i++) {
+        if (i >= steps)
+            break;
+        vec4 qDot1 = dots(q);
+        vec4 qDot2 = dots(q + 0.5*dt*qDot1);
+        vec4 qDot3 = dots(q + 0.5*dt*qDot2);
+        vec4 qDot4 = dots(q + dt*qDot3);
+        q += dt*(qDot1 + 2.0*qDot2 + 2.0*qDot3 + qDot4)/6.0;
+    }
+    fragColor = q;
+}
+)SHADER"},
+    {"./shaders/util/copy.frag", R"SHADER(#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D tex;
+
+void main() {
+    fragColor = texture2D(tex, UV);
+}
+)SHADER"},
+    {"./shaders/util/draw-square.frag", R"SHADER(#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform vec2 bottomLeftPosition;
+uniform vec2 dimensions;
+uniform vec4 color;
+
+void main() {
+    fragColor = vec4(0.0);
+    if (UV.x >= bottomLeftPosition.x
+        && UV.y >= bottomLeftPosition.y
+        && UV.x < (bottomLeftPosition.x + dimensions.x)
+        && UV.y < (bottomLeftPosition.y + dimensions.y))
+        fragColor = color;
+}
+
+)SHADER"},
+    {"./shaders/util/scale.frag", R"SHADER(#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D tex;
+uniform float scale;
+
+void main() {
+    fragColor = scale*texture2D(tex, UV);
+}
+)SHADER"},
+    {"./shaders/util/sub-window.frag", R"SHADER(#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D tex;
+uniform vec4 viewport;
+
+void main() {
+    vec2 r0 = viewport.xy;
+    vec2 wh = viewport.zw;
+    fragColor = texture2D(tex, UV*wh + r0);
+}
+
+)SHADER"},
+    {"./shaders/util/uniform-color.frag", R"SHADER(#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+    
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform vec4 color;
+
+void main() {
+    fragColor = color;
+}
+)SHADER"},
+};
+
+#endif
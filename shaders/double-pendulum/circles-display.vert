@@ -1,8 +1,10 @@
+/* Draw the bobs of every pendulum in the probed part of the grid as
+circles, with one instance for each pendulum. Each of its two circles is a fan
+of CIRCLE_SEGMENTS triangles, which has to match the vertex count of the
+instances. */
 #if __VERSION__ <= 120
-attribute vec4 position;
 varying vec2 UV;
 #else
-in vec4 position;
 out vec2 UV;
 #endif
 
@@ -17,32 +19,45 @@ precision highp float;
 #endif
 
 uniform sampler2D coordTex;
-uniform float length1;
-uniform float length2;
+// Offset and size of the probed part of the grid in texture coordinates
+// of coordTex, and its number of pendulums along each direction.
+uniform vec4 probe;
+uniform ivec2 probeSize;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
 uniform float circleRadius;
 uniform float viewScale;
 uniform vec2 viewOffset;
 
+const int CIRCLE_SEGMENTS = 10;
+const float PI = 3.141592653589793;
+
 void main() {
-    UV = position.xy;
+    ivec2 index = ivec2(gl_InstanceID % probeSize.x,
+                        gl_InstanceID / probeSize.x);
+    UV = probe.xy + probe.zw*(vec2(index) + 0.5)/vec2(probeSize);
     vec4 coord = texture2D(coordTex, UV);
     float pi1 = coord[0], pi2 = coord[1];
     float phi1 = coord[2], phi2 = coord[3];
     vec2 r0 = length1*vec2(sin(phi1), -cos(phi1));
     vec2 r1 = length2*vec2(sin(phi2), -cos(phi2));
-    vec2 r;
-    float circleAngle = position[2];
-    float c = cos(circleAngle), s = sin(circleAngle);
-    float circleRad = circleRadius;
-    if (position[3] < 1.0) {
-        r = viewOffset + viewScale*r0;
-    } else if (position[3] < 2.0) {
-        r = viewOffset + viewScale*r0 + circleRad*vec2(c, s);
-    } else if (position[3] < 3.0) {
-        r = viewOffset + viewScale*(r0 + r1);
-    } else if (position[3] < 4.0) {
-        r = viewOffset + viewScale*(r0 + r1) 
-            + circleRad*vec2(c, s);
+    int triangle = gl_VertexID/3;
+    int corner = gl_VertexID - 3*triangle;
+    vec2 r = (triangle < CIRCLE_SEGMENTS)?
+        viewOffset + viewScale*r0: viewOffset + viewScale*(r0 + r1);
+    // The first corner of each triangle is the center of the circle,
+    // and the other two are on its edge.
+    if (corner > 0) {
+        int segment = triangle % CIRCLE_SEGMENTS + corner - 1;
+        float circleAngle = 2.0*PI*float(segment)/float(CIRCLE_SEGMENTS);
+        r += circleRadius*vec2(cos(circleAngle), sin(circleAngle));
     }
     gl_Position = vec4(r, 0.0, 1.0);
 
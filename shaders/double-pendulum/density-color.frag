@@ -0,0 +1,34 @@
+/* Colour the density of the bobs of the probed pendulums, given as the
+number of bobs that landed on each texel of densityTex, on a logarithmic
+scale going from black through red and yellow to white. */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D densityTex;
+
+// Half floats only count every bob up to this many, so denser texels get
+// the last colour.
+const float MAX_DENSITY = 2048.0;
+
+void main() {
+    float density = texture2D(densityTex, UV)[0];
+    float x = min(log(1.0 + density)/log(1.0 + MAX_DENSITY), 1.0);
+    fragColor = vec4(clamp(3.0*x, 0.0, 1.0),
+                     clamp(3.0*x - 1.0, 0.0, 1.0),
+                     clamp(3.0*x - 2.0, 0.0, 1.0), 1.0);
+}
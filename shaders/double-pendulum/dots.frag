@@ -1,4 +1,6 @@
-/* Expressions for the time derivatives of each of the coordinates */
+/* Expressions for the time derivatives of each of the coordinates.
+Generated by make_dots_kernels.py from the Hamiltonian of symbolic.ipynb.
+Do not edit. */
 #if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
 #define texture2D texture
 #else
@@ -8,7 +10,7 @@
 #if (__VERSION__ > 120) || defined(GL_ES)
 precision highp float;
 #endif
-    
+
 #if __VERSION__ <= 120
 varying vec2 UV;
 #define fragColor gl_FragColor
@@ -18,56 +20,43 @@ out vec4 fragColor;
 #endif
 
 uniform sampler2D coordinateTex;
-uniform float mass1;
-uniform float mass2;
-uniform float length1;
-uniform float length2;
-uniform float gravity;
-
-/* Time derivative of the angular positions phi1 and phi2. */
-float dotPhi(int i, vec4 coord) {
-    float pi1 = coord[0], pi2 = coord[1];
-    float phi1 = coord[2], phi2 = coord[3];
-    float m11 = (mass1 + mass2)*length1;
-    float m12 = mass2*length1*length2*cos(phi1 - phi2);
-    float m21 = mass2*length1*length2*cos(phi1 - phi2);
-    float m22 = mass2*length2;
-    if (i == 1)
-        return -m22*pi1/(m12*m21 - m22*m11) + m12*pi2/(m12*m21 - m22*m11);
-    else if (i == 2)
-        return m21*pi1/(m12*m21 - m22*m11) - m11*pi2/(m12*m21 - m22*m11);
-}
-
-float dotPhi1(vec4 coord) {
-    return dotPhi(1, coord);
-}
-
-float dotPhi2(vec4 coord) {
-    return dotPhi(2, coord);
-}
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
 
-/* Time derivative of the conjugate momenta pi1 and pi2.
- These are computed from the Hamiltonian using Sympy.
- */
-float dotPi(int i, vec4 coord) {
+vec4 dots(vec4 coord) {
     float pi1 = coord[0], pi2 = coord[1];
     float phi1 = coord[2], phi2 = coord[3];
-    if (i == 1)
-        return -gravity*length1*(mass1+mass2)*sin(phi1)+4.0*length1*length2*mass2*(0.5*mass1+0.5*mass2)*pow((length1*pi2*cos(phi1-phi2)-pi1),2.0)*sin(phi1-phi2)*cos(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),3.0)+4.0*length1*length2*mass2*(length1*pi2*cos(phi1-phi2)-pi1)*(length2*mass2*pi1*cos(phi1-phi2)-pi2*(mass1+mass2))*sin(phi1-phi2)*pow(cos(phi1-phi2),2.0)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),3.0)+2.0*length1*length2*pow((length2*mass2*pi1*cos(phi1-phi2)-pi2*(mass1+mass2)),2.0)*sin(phi1-phi2)*cos(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),3.0)-2.0*length1*pi2*(0.5*mass1+0.5*mass2)*(length1*pi2*cos(phi1-phi2)-pi1)*sin(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0)-3.0*length1*pi2*(length2*mass2*pi1*cos(phi1-phi2)-pi2*(mass1+mass2))*sin(phi1-phi2)*cos(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0)-3.0*length2*mass2*pi1*(length1*pi2*cos(phi1-phi2)-pi1)*sin(phi1-phi2)*cos(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0)-1.0*length2*pi1*(length2*mass2*pi1*cos(phi1-phi2)-pi2*(mass1+mass2))*sin(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0)+2.0*pi1*pi2*sin(phi1-phi2)/(length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2)-(length1*pi2*cos(phi1-phi2)-pi1)*(length2*mass2*pi1*cos(phi1-phi2)-pi2*(mass1+mass2))*sin(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0);
-    else if (i == 2)
-        return -gravity*length2*mass2*sin(phi2)-4.0*length1*length2*mass2*(0.5*mass1+0.5*mass2)*pow((length1*pi2*cos(phi1-phi2)-pi1),2.0)*sin(phi1-phi2)*cos(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),3.0)-4.0*length1*length2*mass2*(length1*pi2*cos(phi1-phi2)-pi1)*(length2*mass2*pi1*cos(phi1-phi2)-pi2*(mass1+mass2))*sin(phi1-phi2)*pow(cos(phi1-phi2),2.0)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),3.0)-2.0*length1*length2*pow((length2*mass2*pi1*cos(phi1-phi2)-pi2*(mass1+mass2)),2.0)*sin(phi1-phi2)*cos(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),3.0)+2.0*length1*pi2*(0.5*mass1+0.5*mass2)*(length1*pi2*cos(phi1-phi2)-pi1)*sin(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0)+3.0*length1*pi2*(length2*mass2*pi1*cos(phi1-phi2)-pi2*(mass1+mass2))*sin(phi1-phi2)*cos(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0)+3.0*length2*mass2*pi1*(length1*pi2*cos(phi1-phi2)-pi1)*sin(phi1-phi2)*cos(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0)+1.0*length2*pi1*(length2*mass2*pi1*cos(phi1-phi2)-pi2*(mass1+mass2))*sin(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0)-2.0*pi1*pi2*sin(phi1-phi2)/(length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2)+(length1*pi2*cos(phi1-phi2)-pi1)*(length2*mass2*pi1*cos(phi1-phi2)-pi2*(mass1+mass2))*sin(phi1-phi2)/pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0);
-}
-
-float dotPi1(vec4 coord) {
-    return dotPi(1, coord);
-}
-
-float dotPi2(vec4 coord) {
-    return dotPi(2, coord);
+    float sin1 = sin(phi1), cos1 = cos(phi1);
+    float sin2 = sin(phi2), cos2 = cos(phi2);
+    float s = sin1*cos2 - cos1*sin2;
+    float c = cos1*cos2 + sin1*sin2;
+    float k0 = length1*length2*mass2;
+    float k1 = -mass1 - mass2;
+    float k2 = -1.0/length1;
+    float k3 = -(mass1 + mass2)/(length2*mass2);
+    float k4 = -length1*length1*length2*length2*mass2*mass2;
+    float k5 = -length1*length2*mass2*(mass1 + mass2)*(length1 + length2 - 3.0);
+    float k6 = length1*length1*length2*mass2*(length1 - 1.0)*(mass1 + mass2);
+    float k7 = length1*length2*length2*mass2*mass2*(length2 - 1.0);
+    float k8 = -gravity*length1*(mass1 + mass2);
+    float k9 = -gravity*length2*mass2;
+    float inv_d = 1.0/(c*c*k0 + k1);
+    float dot_phi1 = inv_d*(c*pi2 + k2*pi1);
+    float dot_phi2 = inv_d*(c*pi1 + k3*pi2);
+    float dh_dc = inv_d*(c*dot_phi1*dot_phi1*k6 + c*dot_phi2*dot_phi2*k7 + dot_phi1*dot_phi2*(c*c*k4 + k5));
+    float dot_pi1 = dh_dc*s + k8*sin1;
+    float dot_pi2 = -dh_dc*s + k9*sin2;
+    return vec4(dot_pi1, dot_pi2, dot_phi1, dot_phi2);
 }
 
 void main() {
     vec4 coord = texture2D(coordinateTex, UV);
-    fragColor = vec4(dotPi1(coord), dotPi2(coord), 
-                     dotPhi1(coord), dotPhi2(coord));
+    fragColor = dots(coord);
 }
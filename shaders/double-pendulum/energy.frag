@@ -18,11 +18,15 @@ out vec4 fragColor;
 #endif
 
 uniform sampler2D coordTex;
-uniform float mass1;
-uniform float mass2;
-uniform float length1;
-uniform float length2;
-uniform float gravity;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
 
 /* Time derivative of the angular positions phi1 and phi2. */
 float dotPhi(int i, vec4 coord) {
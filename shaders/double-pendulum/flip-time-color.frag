@@ -0,0 +1,66 @@
+/* Colour each pendulum by the time until either of its arms first flips,
+on a logarithmic scale in units of timeUnit, going from red for the
+quickest flips through the hues to magenta. Those that have not flipped
+are left black. */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D flipTimeTex;
+uniform float timeUnit;
+
+const float PI = 3.141592653589793;
+// Flips that take longer than this many time units get the last colour.
+const float MAX_TIME = 1000.0;
+
+vec3 argumentToColor(float argVal) {
+    float maxCol = 1.0;
+    float minCol = 50.0/255.0;
+    float colRange = maxCol - minCol;
+    if (argVal <= PI/3.0 && argVal >= 0.0) {
+        return vec3(maxCol,
+                    minCol + colRange*argVal/(PI/3.0), minCol);
+    } else if (argVal > PI/3.0 && argVal <= 2.0*PI/3.0){
+        return vec3(maxCol - colRange*(argVal - PI/3.0)/(PI/3.0),
+                    maxCol, minCol);
+    } else if (argVal > 2.0*PI/3.0 && argVal <= PI){
+        return vec3(minCol, maxCol,
+                    minCol + colRange*(argVal - 2.0*PI/3.0)/(PI/3.0));
+    } else if (argVal > PI && argVal <= 4.0*PI/3.0){
+        return vec3(minCol,
+                    maxCol - (colRange*(argVal - PI)/(PI/3.0)), 
+                    maxCol);
+    } else if (argVal > 4.0*PI/3.0 && argVal <= 5.0*PI/3.0) {
+        return vec3(minCol + (colRange*(argVal - 4.0*PI/3.0)/(PI/3.0)),
+                    minCol, maxCol);
+    } else if (argVal > 5.0*PI/3.0 && argVal < 2.0*PI){
+        return vec3(maxCol, minCol,
+                    maxCol - colRange*(argVal - 5.0*PI/3.0)/(PI/3.0));
+    } else {
+        return vec3(minCol, maxCol, maxCol);
+    }
+}
+
+void main() {
+    float flipTime = texture2D(flipTimeTex, UV)[0];
+    if (flipTime <= 0.0) {
+        fragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    float x = log(1.0 + flipTime/timeUnit)/log(1.0 + MAX_TIME);
+    fragColor = vec4(argumentToColor(5.0*PI/3.0*min(x, 1.0)), 1.0);
+}
@@ -0,0 +1,34 @@
+/* Record the time at which either arm of each pendulum first goes over
+the top, where a time of zero means that it has not flipped yet. */
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D coordTex;
+uniform sampler2D flipTimeTex;
+uniform float time;
+
+const float PI = 3.141592653589793;
+
+void main() {
+    vec4 coord = texture2D(coordTex, UV);
+    float phi1 = coord[2], phi2 = coord[3];
+    float flipTime = texture2D(flipTimeTex, UV)[0];
+    if (flipTime == 0.0 && (abs(phi1) > PI || abs(phi2) > PI))
+        flipTime = time;
+    fragColor = vec4(flipTime, 0.0, 0.0, 1.0);
+}
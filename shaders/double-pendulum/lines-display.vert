@@ -1,8 +1,9 @@
+/* Draw the arms of every pendulum in the probed part of the grid, with one
+instance for each pendulum made of two line segments, whose ends are given by
+gl_VertexID. */
 #if __VERSION__ <= 120
-attribute vec4 position;
 varying vec2 UV;
 #else
-in vec4 position;
 out vec2 UV;
 #endif
 
@@ -17,26 +18,37 @@ precision highp float;
 #endif
 
 uniform sampler2D coordTex;
-uniform float length1;
-uniform float length2;
+// Offset and size of the probed part of the grid in texture coordinates
+// of coordTex, and its number of pendulums along each direction.
+uniform vec4 probe;
+uniform ivec2 probeSize;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
 uniform float viewScale;
 uniform vec2 viewOffset;
 
 void main() {
-    UV = position.xy;
+    ivec2 index = ivec2(gl_InstanceID % probeSize.x,
+                        gl_InstanceID / probeSize.x);
+    UV = probe.xy + probe.zw*(vec2(index) + 0.5)/vec2(probeSize);
     vec4 coord = texture2D(coordTex, UV);
     float pi1 = coord[0], pi2 = coord[1];
     float phi1 = coord[2], phi2 = coord[3];
     vec2 r0 = length1*vec2(sin(phi1), -cos(phi1));
     vec2 r1 = length2*vec2(sin(phi2), -cos(phi2));
     vec2 r;
-    if (position[3] < 1.0)
+    if (gl_VertexID == 0)
         r = viewOffset;
-    else if (position[3] < 2.0)
-        r = viewOffset + viewScale*r0;
-    else if (position[3] < 3.0)
+    else if (gl_VertexID == 1 || gl_VertexID == 2)
         r = viewOffset + viewScale*r0;
-    else if (position[3] < 4.0)
+    else
         r = viewOffset + viewScale*(r0 + r1);
     gl_Position = vec4(r, 0.0, 1.0);
 
@@ -0,0 +1,131 @@
+/* Steps of Tao's explicit symplectic method for non-separable
+Hamiltonians. The pendulum is split into two copies bound together by a term
+of strength omega, and the flows of H(phi, pi_e), H(phi_e, pi) and of the
+binding term are composed into the Strang splitting
+A(h/2) B(h/2) C(h) B(h/2) A(h/2), then into a fourth order method by the
+triple jump of Yoshida. The copies are averaged at the end of every step, as
+in cpu_integration.cpp, and a single pass takes as many steps as given by
+the steps uniform.
+
+References:
+    Molei Tao, Explicit symplectic approximation of nonseparable
+    Hamiltonians: algorithm and long time performance, Phys. Rev. E 94,
+    043303 (2016).
+
+    Pauli Pihajoki, Explicit methods in extended phase space for
+    inseparable Hamiltonian problems, Celest. Mech. Dyn. Astr. 121,
+    211-231 (2015).
+*/
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D qTex;
+uniform float dt;
+uniform int steps;
+uniform float omega;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+
+// GENERATED_BEGIN by make_dots_kernels.py
+vec4 dots(vec4 coord) {
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    float sin1 = sin(phi1), cos1 = cos(phi1);
+    float sin2 = sin(phi2), cos2 = cos(phi2);
+    float s = sin1*cos2 - cos1*sin2;
+    float c = cos1*cos2 + sin1*sin2;
+    float k0 = length1*length2*mass2;
+    float k1 = -mass1 - mass2;
+    float k2 = -1.0/length1;
+    float k3 = -(mass1 + mass2)/(length2*mass2);
+    float k4 = -length1*length1*length2*length2*mass2*mass2;
+    float k5 = -length1*length2*mass2*(mass1 + mass2)*(length1 + length2 - 3.0);
+    float k6 = length1*length1*length2*mass2*(length1 - 1.0)*(mass1 + mass2);
+    float k7 = length1*length2*length2*mass2*mass2*(length2 - 1.0);
+    float k8 = -gravity*length1*(mass1 + mass2);
+    float k9 = -gravity*length2*mass2;
+    float inv_d = 1.0/(c*c*k0 + k1);
+    float dot_phi1 = inv_d*(c*pi2 + k2*pi1);
+    float dot_phi2 = inv_d*(c*pi1 + k3*pi2);
+    float dh_dc = inv_d*(c*dot_phi1*dot_phi1*k6 + c*dot_phi2*dot_phi2*k7 + dot_phi1*dot_phi2*(c*c*k4 + k5));
+    float dot_pi1 = dh_dc*s + k8*sin1;
+    float dot_pi2 = -dh_dc*s + k9*sin2;
+    return vec4(dot_pi1, dot_pi2, dot_phi1, dot_phi2);
+}
+// GENERATED_END
+
+const float GAMMA1 = 1.3512071919596578;
+const float GAMMA2 = -1.7024143839193155;
+
+vec4 q, e;
+
+void flowA(float d) {
+    vec4 f = dots(vec4(e.xy, q.zw));
+    q.xy += d*f.xy;
+    e.zw += d*f.zw;
+}
+
+void flowB(float d) {
+    vec4 f = dots(vec4(q.xy, e.zw));
+    q.zw += d*f.zw;
+    e.xy += d*f.xy;
+}
+
+/* Rotates the difference between the two copies while keeping their sum
+fixed. */
+void flowC(float d) {
+    float c = cos(2.0*omega*d), s = sin(2.0*omega*d);
+    vec4 sum = q + e, diff = q - e;
+    vec4 rotated = vec4(c*diff.xy - s*diff.zw, c*diff.zw + s*diff.xy);
+    q = 0.5*(sum + rotated);
+    e = 0.5*(sum - rotated);
+}
+
+// Loops need a constant bound in older versions of GLSL.
+#define MAX_STEPS 32
+
+void main() {
+    q = texture2D(qTex, UV);
+    for (int i = 0; i < MAX_STEPS; i++) {
+        if (i >= steps)
+            break;
+        e = q;
+        flowA(0.5*GAMMA1*dt);
+        flowB(0.5*GAMMA1*dt);
+        flowC(GAMMA1*dt);
+        flowB(0.5*GAMMA1*dt);
+        flowA(0.5*(GAMMA1 + GAMMA2)*dt);
+        flowB(0.5*GAMMA2*dt);
+        flowC(GAMMA2*dt);
+        flowB(0.5*GAMMA2*dt);
+        flowA(0.5*(GAMMA1 + GAMMA2)*dt);
+        flowB(0.5*GAMMA1*dt);
+        flowC(GAMMA1*dt);
+        flowB(0.5*GAMMA1*dt);
+        flowA(0.5*GAMMA1*dt);
+        q = 0.5*(q + e);
+    }
+    fragColor = q;
+}
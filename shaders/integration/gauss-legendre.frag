@@ -0,0 +1,96 @@
+/* Steps of the two stage Gauss-Legendre method, which is implicit,
+symplectic and of fourth order. Its stages are found by fixed point
+iteration, which converges as long as dt is small compared to the time scale
+of the motion. A single pass takes as many steps as given by the steps
+uniform.
+
+Reference:
+    Hairer, Lubich and Wanner, Geometric Numerical Integration,
+    chapter II.1.3 (Gauss collocation methods).
+*/
+#if (__VERSION__ >= 330) || (defined(GL_ES) && __VERSION__ >= 300)
+#define texture2D texture
+#else
+#define texture texture2D
+#endif
+
+#if (__VERSION__ > 120) || defined(GL_ES)
+precision highp float;
+#endif
+
+#if __VERSION__ <= 120
+varying vec2 UV;
+#define fragColor gl_FragColor
+#else
+in vec2 UV;
+out vec4 fragColor;
+#endif
+
+uniform sampler2D qTex;
+uniform float dt;
+uniform int steps;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+
+// GENERATED_BEGIN by make_dots_kernels.py
+vec4 dots(vec4 coord) {
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    float sin1 = sin(phi1), cos1 = cos(phi1);
+    float sin2 = sin(phi2), cos2 = cos(phi2);
+    float s = sin1*cos2 - cos1*sin2;
+    float c = cos1*cos2 + sin1*sin2;
+    float k0 = length1*length2*mass2;
+    float k1 = -mass1 - mass2;
+    float k2 = -1.0/length1;
+    float k3 = -(mass1 + mass2)/(length2*mass2);
+    float k4 = -length1*length1*length2*length2*mass2*mass2;
+    float k5 = -length1*length2*mass2*(mass1 + mass2)*(length1 + length2 - 3.0);
+    float k6 = length1*length1*length2*mass2*(length1 - 1.0)*(mass1 + mass2);
+    float k7 = length1*length2*length2*mass2*mass2*(length2 - 1.0);
+    float k8 = -gravity*length1*(mass1 + mass2);
+    float k9 = -gravity*length2*mass2;
+    float inv_d = 1.0/(c*c*k0 + k1);
+    float dot_phi1 = inv_d*(c*pi2 + k2*pi1);
+    float dot_phi2 = inv_d*(c*pi1 + k3*pi2);
+    float dh_dc = inv_d*(c*dot_phi1*dot_phi1*k6 + c*dot_phi2*dot_phi2*k7 + dot_phi1*dot_phi2*(c*c*k4 + k5));
+    float dot_pi1 = dh_dc*s + k8*sin1;
+    float dot_pi2 = -dh_dc*s + k9*sin2;
+    return vec4(dot_pi1, dot_pi2, dot_phi1, dot_phi2);
+}
+// GENERATED_END
+
+#define MAX_ITERATIONS 12
+// Loops need a constant bound in older versions of GLSL.
+#define MAX_STEPS 32
+
+const float A11 = 0.25, A12 = 0.25 - 0.28867513;
+const float A21 = 0.25 + 0.28867513, A22 = 0.25;
+
+void main() {
+    vec4 q = texture2D(qTex, UV);
+    vec4 k1 = dots(q), k2 = k1;
+    for (int n = 0; n < MAX_STEPS; n++) {
+        if (n >= steps)
+            break;
+        vec4 scale = 4.0e-7*(1.0 + abs(q));
+        for (int i = 0; i < MAX_ITERATIONS; i++) {
+            vec4 nextK1 = dots(q + dt*(A11*k1 + A12*k2));
+            vec4 nextK2 = dots(q + dt*(A21*k1 + A22*k2));
+            vec4 change = abs(dt)*(abs(nextK1 - k1) + abs(nextK2 - k2));
+            k1 = nextK1;
+            k2 = nextK2;
+            if (all(lessThanEqual(change, scale)))
+                break;
+        }
+        q += 0.5*dt*(k1 + k2);
+    }
+    fragColor = q;
+}
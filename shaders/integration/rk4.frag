@@ -1,6 +1,6 @@
-/* RK4 formula from Runge-Kutta methods Wikipedia page.
-The derivatives of the coordinates are not computed here but in
-previous computations, where here they are taken as input.
+/* RK4 steps of the double pendulum, with the four stages of every step
+computed in registers, so that a single pass takes the pendulums through
+as many steps as given by the steps uniform.
 
 Reference:
     Wikipedia - Runge–Kutta methods
@@ -25,17 +25,59 @@ out vec4 fragColor;
 #endif
 
 uniform sampler2D qTex;
-uniform sampler2D qDotTex1;
-uniform sampler2D qDotTex2;
-uniform sampler2D qDotTex3;
-uniform sampler2D qDotTex4;
 uniform float dt;
+uniform int steps;
+#ifndef PHYSICS_CONSTANTS
+layout(std140) uniform PhysicsParams {
+    float mass1;
+    float mass2;
+    float length1;
+    float length2;
+    float gravity;
+};
+#endif
+
+// GENERATED_BEGIN by make_dots_kernels.py
+vec4 dots(vec4 coord) {
+    float pi1 = coord[0], pi2 = coord[1];
+    float phi1 = coord[2], phi2 = coord[3];
+    float sin1 = sin(phi1), cos1 = cos(phi1);
+    float sin2 = sin(phi2), cos2 = cos(phi2);
+    float s = sin1*cos2 - cos1*sin2;
+    float c = cos1*cos2 + sin1*sin2;
+    float k0 = length1*length2*mass2;
+    float k1 = -mass1 - mass2;
+    float k2 = -1.0/length1;
+    float k3 = -(mass1 + mass2)/(length2*mass2);
+    float k4 = -length1*length1*length2*length2*mass2*mass2;
+    float k5 = -length1*length2*mass2*(mass1 + mass2)*(length1 + length2 - 3.0);
+    float k6 = length1*length1*length2*mass2*(length1 - 1.0)*(mass1 + mass2);
+    float k7 = length1*length2*length2*mass2*mass2*(length2 - 1.0);
+    float k8 = -gravity*length1*(mass1 + mass2);
+    float k9 = -gravity*length2*mass2;
+    float inv_d = 1.0/(c*c*k0 + k1);
+    float dot_phi1 = inv_d*(c*pi2 + k2*pi1);
+    float dot_phi2 = inv_d*(c*pi1 + k3*pi2);
+    float dh_dc = inv_d*(c*dot_phi1*dot_phi1*k6 + c*dot_phi2*dot_phi2*k7 + dot_phi1*dot_phi2*(c*c*k4 + k5));
+    float dot_pi1 = dh_dc*s + k8*sin1;
+    float dot_pi2 = -dh_dc*s + k9*sin2;
+    return vec4(dot_pi1, dot_pi2, dot_phi1, dot_phi2);
+}
+// GENERATED_END
+
+// Loops need a constant bound in older versions of GLSL.
+#define MAX_STEPS 32
 
 void main() {
-    vec4 q0 = texture2D(qTex, UV);
-    vec4 qDot1 = texture2D(qDotTex1, UV); 
-    vec4 qDot2 = texture2D(qDotTex2, UV); 
-    vec4 qDot3 = texture2D(qDotTex3, UV); 
-    vec4 qDot4 = texture2D(qDotTex4, UV); 
-    fragColor = q0 + dt*(qDot1 + 2.0*qDot2 + 2.0*qDot3 + qDot4)/6.0;
-}
\ No newline at end of file
+    vec4 q = texture2D(qTex, UV);
+    for (int i = 0; i < MAX_STEPS; i++) {
+        if (i >= steps)
+            break;
+        vec4 qDot1 = dots(q);
+        vec4 qDot2 = dots(q + 0.5*dt*qDot1);
+        vec4 qDot3 = dots(q + 0.5*dt*qDot2);
+        vec4 qDot4 = dots(q + dt*qDot3);
+        q += dt*(qDot1 + 2.0*qDot2 + 2.0*qDot3 + qDot4)/6.0;
+    }
+    fragColor = q;
+}
@@ -0,0 +1,307 @@
+/* Minimal portable SIMD layer for the CPU integrator, built on the
+GCC/Clang vector extensions so that the same templated kernel can be
+compiled for 128-bit (SSE2/NEON/WASM), 256-bit (AVX2) and 512-bit (AVX-512)
+registers, of either doubles or floats. The ISA actually used for the
+wider types is selected per function with __attribute__((target(...))), and
+at runtime by simd_level().
+
+Only the handful of operations needed by the double pendulum kernel are
+provided: loads/stores, a lane select, and a vectorized sincos.
+
+References for the sincos implementation:
+
+ - Cephes Mathematical Library, sin.c (coefficients of the sine and cosine
+   polynomials on [-pi/4, pi/4]).
+ - Cody, Waite. Software Manual for the Elementary Functions.
+   Prentice-Hall (1980). (Three part pi/2 argument reduction.)
+*/
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <type_traits>
+
+#ifndef _SIMD_
+#define _SIMD_
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_X86 0
+#define SIMD_TARGET(isa)
+#endif
+
+#define SIMD_INLINE inline __attribute__((always_inline))
+
+// Everything taking or returning a vector type is always inlined into
+// a function compiled for the matching ISA, so GCC's warnings about
+// the calling convention of AVX types do not apply.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+typedef double f64x2 __attribute__((vector_size(16)));
+typedef double f64x4 __attribute__((vector_size(32)));
+typedef double f64x8 __attribute__((vector_size(64)));
+typedef int64_t i64x2 __attribute__((vector_size(16)));
+typedef int64_t i64x4 __attribute__((vector_size(32)));
+typedef int64_t i64x8 __attribute__((vector_size(64)));
+typedef float f32x4 __attribute__((vector_size(16)));
+typedef float f32x8 __attribute__((vector_size(32)));
+typedef float f32x16 __attribute__((vector_size(64)));
+typedef int32_t i32x4 __attribute__((vector_size(16)));
+typedef int32_t i32x8 __attribute__((vector_size(32)));
+typedef int32_t i32x16 __attribute__((vector_size(64)));
+
+/* Widest instruction set usable on the running machine. */
+enum SIMDLevel {
+    SIMD_128=0, SIMD_AVX2, SIMD_AVX512
+};
+
+inline SIMDLevel simd_level() {
+    #if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SIMD_AVX2;
+    #endif
+    return SIMD_128;
+}
+
+inline const char *simd_level_name(SIMDLevel level) {
+    switch(level) {
+        case SIMD_AVX512:
+        return "AVX-512";
+        case SIMD_AVX2:
+        return "AVX2";
+        default:
+        return (SIMD_X86)? "SSE2": "128-bit";
+    }
+}
+
+template <typename V> struct SIMDTraits {
+    // Scalar fallback, so that kernels written against V also accept
+    // plain float, double and long double.
+    typedef V scalar;
+    typedef int64_t mask;
+    enum { WIDTH=1 };
+};
+
+template <> struct SIMDTraits<f64x2> {
+    typedef double scalar;
+    typedef i64x2 mask;
+    enum { WIDTH=2 };
+};
+
+template <> struct SIMDTraits<f64x4> {
+    typedef double scalar;
+    typedef i64x4 mask;
+    enum { WIDTH=4 };
+};
+
+template <> struct SIMDTraits<f64x8> {
+    typedef double scalar;
+    typedef i64x8 mask;
+    enum { WIDTH=8 };
+};
+
+template <> struct SIMDTraits<f32x4> {
+    typedef float scalar;
+    typedef i32x4 mask;
+    enum { WIDTH=4 };
+};
+
+template <> struct SIMDTraits<f32x8> {
+    typedef float scalar;
+    typedef i32x8 mask;
+    enum { WIDTH=8 };
+};
+
+template <> struct SIMDTraits<f32x16> {
+    typedef float scalar;
+    typedef i32x16 mask;
+    enum { WIDTH=16 };
+};
+
+/* Vector types of each register width for a given scalar type. There are
+none for long double, which is only ever computed one value at a time. */
+template <typename S> struct SIMDVectors {
+    typedef S v128;
+    typedef S v256;
+    typedef S v512;
+};
+
+template <> struct SIMDVectors<double> {
+    typedef f64x2 v128;
+    typedef f64x4 v256;
+    typedef f64x8 v512;
+};
+
+template <> struct SIMDVectors<float> {
+    typedef f32x4 v128;
+    typedef f32x8 v256;
+    typedef f32x16 v512;
+};
+
+template <typename V>
+SIMD_INLINE V simd_load(const typename SIMDTraits<V>::scalar *p) {
+    V v;
+    memcpy(&v, p, sizeof(V));
+    return v;
+}
+
+template <typename V>
+SIMD_INLINE void simd_store(typename SIMDTraits<V>::scalar *p, const V &v) {
+    memcpy(p, &v, sizeof(V));
+}
+
+template <typename V>
+SIMD_INLINE V simd_select(
+    const typename SIMDTraits<V>::mask &m, const V &a, const V &b,
+    std::false_type) {
+    typedef typename SIMDTraits<V>::mask M;
+    return (V)(((M)a & m) | ((M)b & ~m));
+}
+
+template <typename V>
+SIMD_INLINE V simd_select(
+    const typename SIMDTraits<V>::mask &m, const V &a, const V &b,
+    std::true_type) {
+    return (m)? a: b;
+}
+
+/* Lanes of a where m is all ones, lanes of b where m is zero. For the
+scalar types m is just a truth value. */
+template <typename V>
+SIMD_INLINE V simd_select(
+    const typename SIMDTraits<V>::mask &m, const V &a, const V &b) {
+    return simd_select<V>(
+        m, a, b, std::integral_constant<bool, SIMDTraits<V>::WIDTH == 1>());
+}
+
+template <typename M>
+SIMD_INLINE bool simd_any(const M &m, std::false_type) {
+    for (size_t i = 0; i < sizeof(M)/sizeof(m[0]); i++)
+        if (m[i])
+            return true;
+    return false;
+}
+
+template <typename M>
+SIMD_INLINE bool simd_any(const M &m, std::true_type) {
+    return m != 0;
+}
+
+/* Whether any lane of the mask m is set. */
+template <typename V>
+SIMD_INLINE bool simd_any(const typename SIMDTraits<V>::mask &m) {
+    return simd_any(
+        m, std::integral_constant<bool, SIMDTraits<V>::WIDTH == 1>());
+}
+
+/* x^y for every lane of x. There is no vectorized pow, so this is done a
+lane at a time; it is only meant for code that runs far less often than
+the derivative kernels, like step size control. */
+template <typename V>
+SIMD_INLINE V simd_pow(const V &x, typename SIMDTraits<V>::scalar y) {
+    typedef typename SIMDTraits<V>::scalar S;
+    V r = x;
+    S *lanes = (S *)&r;
+    for (int i = 0; i < SIMDTraits<V>::WIDTH; i++)
+        lanes[i] = std::pow(lanes[i], y);
+    return r;
+}
+
+/* sin(x) and cos(x) for every lane of x. The argument is reduced to
+r = x - n*pi/2 with |r| <= pi/4, where the polynomials below are accurate to
+within a couple of ulps; n mod 4 then picks the sign and which of the two
+polynomials gives each result. Accuracy degrades once |x| reaches ~1e9,
+which is far beyond the angles reached by any pendulum in the simulation.*/
+template <typename V>
+SIMD_INLINE void simd_sincos(const V &x, V &sin_x, V &cos_x, double) {
+    typedef typename SIMDTraits<V>::mask M;
+    // 1.5*2^52: adding then subtracting it rounds to the nearest integer,
+    // and leaves that integer in the low mantissa bits of the sum.
+    const double ROUND = 6755399441055744.0;
+    const double TWO_OVER_PI = 0.63661977236758134308;
+    const double PIO2_1 = 1.57079625129699707031;
+    const double PIO2_2 = 7.54978941586159635335e-08;
+    const double PIO2_3 = 5.39030285815811905290e-15;
+    V shifted = x*TWO_OVER_PI + ROUND;
+    V n = shifted - ROUND;
+    M quadrant = (M)shifted;
+    V r = ((x - n*PIO2_1) - n*PIO2_2) - n*PIO2_3;
+    V z = r*r;
+    V s = r + r*z*(-1.66666666666666307295e-1
+            + z*(8.33333333332211858878e-3
+            + z*(-1.98412698295895385996e-4
+            + z*(2.75573136213857245213e-6
+            + z*(-2.50507477628578072866e-8
+            + z*1.58962301576546568060e-10)))));
+    V c = 1.0 - 0.5*z + z*z*(4.16666666666665929218e-2
+            + z*(-1.38888888888730564116e-3
+            + z*(2.48015872888517045348e-5
+            + z*(-2.75573141792967388112e-7
+            + z*(2.08757008419747316778e-9
+            + z*(-1.13585365213876817300e-11))))));
+    M swap = ((quadrant & 1) != 0);
+    M sign_bit = (M)(-V{});
+    M sin_sign = (quadrant << 62) & sign_bit;
+    M cos_sign = ((quadrant + 1) << 62) & sign_bit;
+    sin_x = (V)((M)simd_select<V>(swap, c, s) ^ sin_sign);
+    cos_x = (V)((M)simd_select<V>(swap, s, c) ^ cos_sign);
+}
+
+/* Single precision version of the above, using the shorter polynomials
+of Cephes' sinf.c and cosf.c. Accurate to a couple of ulps up to |x| ~ 1e4.*/
+template <typename V>
+SIMD_INLINE void simd_sincos(const V &x, V &sin_x, V &cos_x, float) {
+    typedef typename SIMDTraits<V>::mask M;
+    // 1.5*2^23, the single precision counterpart of the rounding constant.
+    const float ROUND = 12582912.0F;
+    const float TWO_OVER_PI = 0.636619772F;
+    const float PIO2_1 = 1.5703125F;
+    const float PIO2_2 = 4.837512969970703125e-4F;
+    const float PIO2_3 = 7.54978995489188216e-8F;
+    V shifted = x*TWO_OVER_PI + ROUND;
+    V n = shifted - ROUND;
+    M quadrant = (M)shifted;
+    V r = ((x - n*PIO2_1) - n*PIO2_2) - n*PIO2_3;
+    V z = r*r;
+    V s = r + r*z*(-1.6666654611e-1F
+            + z*(8.3321608736e-3F
+            + z*(-1.9515295891e-4F)));
+    V c = 1.0F - 0.5F*z + z*z*(4.166664568298827e-2F
+            + z*(-1.388731625493765e-3F
+            + z*2.443315711809948e-5F));
+    M swap = ((quadrant & 1) != 0);
+    M sign_bit = (M)(-V{});
+    M sin_sign = (quadrant << 30) & sign_bit;
+    M cos_sign = ((quadrant + 1) << 30) & sign_bit;
+    sin_x = (V)((M)simd_select<V>(swap, c, s) ^ sin_sign);
+    cos_x = (V)((M)simd_select<V>(swap, s, c) ^ cos_sign);
+}
+
+template <typename V>
+SIMD_INLINE void simd_sincos(const V &x, V &sin_x, V &cos_x) {
+    simd_sincos(x, sin_x, cos_x, typename SIMDTraits<V>::scalar());
+}
+
+SIMD_INLINE void simd_sincos(float x, float &sin_x, float &cos_x) {
+    sin_x = sinf(x);
+    cos_x = cosf(x);
+}
+
+SIMD_INLINE void simd_sincos(double x, double &sin_x, double &cos_x) {
+    sin_x = sin(x);
+    cos_x = cos(x);
+}
+
+SIMD_INLINE void simd_sincos(
+    long double x, long double &sin_x, long double &cos_x) {
+    sin_x = sinl(x);
+    cos_x = cosl(x);
+}
+
+#endif
@@ -1,7 +1,42 @@
 #include "simulation.hpp"
-#include "pendulum_wire_frames.hpp"
+#include "shader_sources.hpp"
 
 static const double PI = 3.141592653589793;
+// Binding point of the PhysicsParams uniform block, which holds the pendulum
+// parameters for every program that uses them.
+static const uint32_t PHYSICS_UNIFORM_BINDING = 0;
+
+/* The PhysicsParams uniform block, in its std140 layout. */
+struct PhysicsUniforms {
+    float mass1, mass2;
+    float length1, length2;
+    float gravity;
+    float padding[3];
+};
+
+// Updates, that is calls to time_step and view, over which the pendulum
+// parameters must stay the same before they are compiled into the programs.
+static const int PHYSICS_VARIANT_DELAY = 30;
+
+// Number of triangles in each circle of circles-display.vert.
+static const int CIRCLE_SEGMENTS = 10;
+// The trails are faded by this much on every view, which half floats can
+// resolve. Where it can be drawn to, the packed 11 and 10 bit float format
+// halves the memory and fill rate of the trails, but is too coarse for the
+// fade of a single view, so that they are then faded once every
+// NARROW_TRAIL_FADE_INTERVAL views by as much.
+static const float TRAIL_FADE = 0.996F;
+static const int NARROW_TRAIL_FADE_INTERVAL = 5;
+// The density of the bobs has this many times fewer texels along each
+// side than the view it is shown in, so that more bobs land on each texel.
+static const int DENSITY_DOWNSCALE = 4;
+
+// Size of the work groups of integrate.comp in each dimension.
+static const int COMPUTE_GROUP_SIZE = 8;
+// Must not be more than MAX_STEPS of the integration shaders. Longer
+// passes keep more of the work in registers, but the GPU can not be
+// interrupted for other drawing during a pass.
+static const int MAX_GPU_STEPS_PER_PASS = 32;
 
 static WireFrame get_quad_wire_frame() {
     return WireFrame(
@@ -14,44 +49,97 @@ static WireFrame get_quad_wire_frame() {
     );
 }
 
+static uint32_t get_trail_format() {
+    return (is_color_renderable(GL_R11F_G11F_B10F))?
+        GL_R11F_G11F_B10F: GL_RGBA16F;
+}
+
 Programs::Programs() {
+    // The shaders are read from the program itself, so that it can be
+    // started from anywhere.
+    std::map<std::string, const char *> shaders;
+    for (const EmbeddedShader &shader: EMBEDDED_SHADERS)
+        shaders[shader.path] = shader.source;
+    set_embedded_files(shaders);
     this->copy
-        = Quad::make_program_from_path("./shaders/util/copy.frag");
+        = LazyProgram::quad("./shaders/util/copy.frag");
     this->scale
-        = Quad::make_program_from_path("./shaders/util/scale.frag");
+        = LazyProgram::quad("./shaders/util/scale.frag");
     this->uniform_color
-        = Quad::make_program_from_path("./shaders/util/uniform-color.frag");
-    this->sub_window
-        = Quad::make_program_from_path("./shaders/util/sub-window.frag");
+        = LazyProgram::quad("./shaders/util/uniform-color.frag");
     this->draw_square
-        = Quad::make_program_from_path("./shaders/util/draw-square.frag");
+        = LazyProgram::quad("./shaders/util/draw-square.frag");
     this->rk4 
-        = Quad::make_program_from_path("./shaders/integration/rk4.frag");
+        = LazyProgram::quad("./shaders/integration/rk4.frag");
     this->forward_euler 
-        = Quad::make_program_from_path(
-            "./shaders/integration/forward-euler.frag");
+        = LazyProgram::quad("./shaders/integration/forward-euler.frag");
+    this->gauss_legendre
+        = LazyProgram::quad("./shaders/integration/gauss-legendre.frag");
+    this->extended_phase_space
+        = LazyProgram::quad("./shaders/integration/extended-phase-space.frag");
     this->double_pendulum_init
-        = Quad::make_program_from_path("./shaders/double-pendulum/init.frag");
+        = LazyProgram::quad("./shaders/double-pendulum/init.frag");
     this->double_pendulum_dots
-        = Quad::make_program_from_path("./shaders/double-pendulum/dots.frag");
+        = LazyProgram::quad("./shaders/double-pendulum/dots.frag");
     this->double_pendulum_line_view
-        = make_program_from_paths(
+        = LazyProgram::from_paths(
             "./shaders/double-pendulum/lines-display.vert",
             "./shaders/util/uniform-color.frag");
     this->double_pendulum_points_view
-        = make_program_from_paths(
+        = LazyProgram::from_paths(
             "./shaders/double-pendulum/points-display.vert",
             "./shaders/double-pendulum/color.frag"
         );
     this->double_pendulum_circles_view
-        = make_program_from_paths(
+        = LazyProgram::from_paths(
             "./shaders/double-pendulum/circles-display.vert",
             "./shaders/double-pendulum/color.frag"
         );
     this->color
-         = Quad::make_program_from_path("./shaders/double-pendulum/color.frag");
+         = LazyProgram::quad("./shaders/double-pendulum/color.frag");
     this->energy
-         = Quad::make_program_from_path("./shaders/double-pendulum/energy.frag");
+         = LazyProgram::quad("./shaders/double-pendulum/energy.frag");
+    this->flip_time
+        = LazyProgram::quad("./shaders/double-pendulum/flip-time.frag");
+    this->flip_time_color
+        = LazyProgram::quad("./shaders/double-pendulum/flip-time-color.frag");
+    this->density
+        = LazyProgram::from_paths(
+            "./shaders/double-pendulum/points-display.vert",
+            "./shaders/util/uniform-color.frag");
+    this->density_color
+        = LazyProgram::quad("./shaders/double-pendulum/density-color.frag");
+    this->integrate_compute
+        = LazyProgram::compute("./shaders/integration/integrate.comp");
+    this->init_compute
+        = LazyProgram::compute("./shaders/double-pendulum/init.comp");
+    this->sample_compute
+        = LazyProgram::compute("./shaders/double-pendulum/sample.comp");
+    for (LazyProgram *program: this->physics_programs()) {
+        program->bind_uniform_block("PhysicsParams", PHYSICS_UNIFORM_BINDING);
+        m_uniform_programs.push_back(*program);
+    }
+    const LazyProgram *programs[] = {
+        &this->copy, &this->scale, &this->uniform_color, &this->draw_square,
+        &this->forward_euler, &this->rk4, &this->gauss_legendre,
+        &this->extended_phase_space, &this->double_pendulum_init,
+        &this->double_pendulum_dots, &this->double_pendulum_line_view,
+        &this->double_pendulum_points_view,
+        &this->double_pendulum_circles_view, &this->color, &this->energy,
+        &this->flip_time, &this->flip_time_color, &this->density,
+        &this->density_color, &this->integrate_compute, &this->init_compute,
+        &this->sample_compute
+    };
+    for (const LazyProgram *program: programs)
+        program->start();
+}
+
+static TextureParams within_max_texture_size(TextureParams params) {
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    params.width = std::min(params.width, uint32_t(max_size));
+    params.height = std::min(params.height, uint32_t(max_size));
+    return params;
 }
 
 Frames::Frames(
@@ -91,10 +179,21 @@ Frames::Frames(
             .mag_filter=GL_NEAREST,
         }
     ),
+    flip_tex_params(
+        {
+            .format=GL_R32F,
+            .width=(uint32_t)sim_width,
+            .height=(uint32_t)sim_height,
+            .wrap_s=GL_CLAMP_TO_EDGE,
+            .wrap_t=GL_CLAMP_TO_EDGE,
+            .min_filter=GL_NEAREST,
+            .mag_filter=GL_NEAREST,
+        }
+    ),
     tmp0(Quad{main_view_tex_params}),
     main_render(RenderTarget{main_view_tex_params}),
-    trajectories1(RenderTarget{{
-        .format=GL_RGBA16F, 
+    trajectories(RenderTarget{{
+        .format=get_trail_format(),
         .width=(uint32_t)window_width/2,
         .height=(uint32_t)window_height,
         .wrap_s=GL_CLAMP_TO_EDGE,
@@ -102,276 +201,25 @@ Frames::Frames(
         .min_filter=GL_NEAREST,
         .mag_filter=GL_NEAREST,
     }}),
-    trajectories2(RenderTarget{{
-        .format=GL_RGBA16F, 
-        .width=(uint32_t)window_width/2,
-        .height=(uint32_t)window_height,
+    density(RenderTarget{{
+        .format=GL_R16F,
+        .width=(uint32_t)window_height/DENSITY_DOWNSCALE,
+        .height=(uint32_t)window_height/DENSITY_DOWNSCALE,
         .wrap_s=GL_CLAMP_TO_EDGE,
         .wrap_t=GL_CLAMP_TO_EDGE,
-        .min_filter=GL_NEAREST,
-        .mag_filter=GL_NEAREST,
+        .min_filter=GL_LINEAR,
+        .mag_filter=GL_LINEAR,
     }}),
-    coords(Quad{sim_tex_params}),
-    sub_coords(Quad{sub_tex_params}),
-    tmp1(Quad{sim_tex_params}),
-    tmp2(Quad{sim_tex_params}),
-    tmp3(Quad{sim_tex_params}),
-    rk4 {
-        .ind {
-            Quad{sim_tex_params},
-            Quad{sim_tex_params},
-            Quad{sim_tex_params},
-            Quad{sim_tex_params},
-            Quad{sim_tex_params}
-        }
-    },
-    double_pendulum_lines(
-        get_pendulum_lines_wire_frame(
-            IVec2{.ind{(int)sub_tex_params.width, (int)sub_tex_params.height}}
-        )
-    ),
-    double_pendulum_points(
-        get_pendulum_points_wire_frame(
-            IVec2{.ind{(int)sub_tex_params.width, (int)sub_tex_params.height}}
-        )
-    ),
-    double_pendulum_circles(
-        get_pendulum_circles_wire_frame(
-            IVec2{.ind{(int)sub_tex_params.width, (int)sub_tex_params.height}}
-        )
-    ),
+    // Only given their sizes by init_config, as with the compute shader
+    // backend the grid may be larger than the largest texture.
+    coords(Quad{within_max_texture_size(sim_tex_params)}),
+    flip_times(Quad{within_max_texture_size(flip_tex_params)}),
+    probe_coords(Quad{sub_tex_params}),
     quad_wire_frame(get_quad_wire_frame())
     {
 
 }
 
-CPUIntegration::CPUIntegration() {
-    this->coords = std::vector<Coord>(0);
-    this->tmp_coords = std::vector<Coord>(0);
-    this->rk4 = std::vector<std::vector<Coord>>(0);
-    this->f_coords = std::vector<float>(0);
-}
-
-void CPUIntegration::init_config(sim_2d::SimParams params) {
-    // printf("%d. %d\n", params.gridWidth, params.gridHeight);
-    double min_phi1 = PI*params.minPhi1;
-    double min_phi2 = PI*params.minPhi2;
-    double max_phi1 = PI*params.maxPhi1;
-    double max_phi2 = PI*params.maxPhi2;
-    this->coords = std::vector<Coord>(
-        params.gridWidth*params.gridHeight, 
-        {0.0, 0.0, 0.0, 0.0}
-    );
-    this->tmp_coords = std::vector<Coord>(
-        params.gridWidth*params.gridHeight, 
-        {0.0, 0.0, 0.0, 0.0}
-    );
-    this->f_coords = std::vector<float>(
-        params.gridWidth*params.gridHeight*4, 0.0);
-    this->rk4.resize(0);
-    for (int i = 0; i < 5; i++)
-        this->rk4.push_back(std::vector<Coord>(
-            params.gridWidth*params.gridHeight, 
-            {0.0, 0.0, 0.0, 0.0}));
-    for (int i = 0; i < params.gridHeight; i++) {
-        for (int j = 0; j < params.gridWidth; j++) {
-            int index = i*params.gridWidth + j;
-            double u = double(j + 0.5)/double(params.gridWidth);
-            double v = double(i + 0.5)/double(params.gridHeight);
-            this->coords[index].pi1 = 0.0;
-            this->coords[index].pi2 = 0.0;
-            double phi1 = min_phi1 + u*(max_phi1 - min_phi1);
-            double phi2 = min_phi2 + v*(max_phi2 - min_phi2);
-            this->coords[index].phi1 = phi1;
-            this->coords[index].phi2 = phi2;
-        }
-    }
-}
-
-void CPUIntegration
-::compute_double_pendulum_dots(
-    std::vector<Coord> &dot_coords,
-    const std::vector<Coord> &coords,
-    DoublePendulumParams params) {
-    double mass1 = params.mass1;
-    double mass2 = params.mass2;
-    double length1 = params.length1;
-    double length2 = params.length2;
-    double gravity = params.gravity;
-    for (int i = 0; i < this->coords.size(); i++) {
-        Coord coord = coords[i];
-        double pi1 = coord.pi1, pi2 = coord.pi2;
-        double phi1 = coord.phi1, phi2 = coord.phi2;
-        double m11 = (mass1 + mass2)*length1;
-        double m12 = mass2*length1*length2*cos(phi1 - phi2);
-        double m21 = mass2*length1*length2*cos(phi1 - phi2);
-        double m22 = mass2*length2;
-        double dot_phi1 
-            = -m22*pi1/(m12*m21 - m22*m11) + m12*pi2/(m12*m21 - m22*m11);
-        double dot_phi2
-            = m21*pi1/(m12*m21 - m22*m11) - m11*pi2/(m12*m21 - m22*m11);
-        double dot_pi1 = -gravity*length1*(mass1+mass2)
-            *sin(phi1)+4.0*length1*length2*mass2*(0.5*mass1+0.5*mass2)
-            *pow((length1*pi2*cos(phi1-phi2)-pi1),2.0)*sin(phi1-phi2)
-            *cos(phi1-phi2)/pow((length1*length2*mass2
-                *pow(cos(phi1-phi2),2.0)-mass1-mass2),3.0)+4.0
-                *length1*length2*mass2
-                *(length1*pi2*cos(phi1-phi2)-pi1)
-                *(length2*mass2*pi1*cos(phi1-phi2)-pi2*(mass1+mass2))
-                *sin(phi1-phi2)*pow(cos(phi1-phi2),2.0)
-                /pow((length1*length2*mass2
-                    *pow(cos(phi1-phi2),2.0)-mass1-mass2),3.0)
-                    +2.0*length1*length2
-                    *pow((length2*mass2*pi1*cos(phi1-phi2)
-                    -pi2*(mass1+mass2)),2.0)
-                    *sin(phi1-phi2)*cos(phi1-phi2)/pow((length1*length2*mass2
-                        *pow(cos(phi1-phi2),2.0)-mass1-mass2),3.0)
-                        -2.0*length1*pi2*(0.5*mass1+0.5*mass2)
-                        *(length1*pi2*cos(phi1-phi2)-pi1)
-                        *sin(phi1-phi2)
-                        /pow((length1*length2*mass2
-                            *pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0)
-                            -3.0*length1*pi2*(length2*mass2*pi1
-                                *cos(phi1-phi2)-pi2*(mass1+mass2))
-                                *sin(phi1-phi2)
-                                *cos(phi1-phi2)/pow((length1*length2*mass2
-                                    *pow(cos(phi1-phi2),2.0)
-                                    -mass1-mass2),2.0)-3.0*length2
-                                    *mass2*pi1
-                                    *(length1*pi2*cos(phi1-phi2)-pi1)
-                                    *sin(phi1-phi2)*cos(phi1-phi2)
-                                    /pow((length1*length2*mass2
-                                        *pow(cos(phi1-phi2),2.0)
-                                        -mass1-mass2),2.0)-1.0
-                                        *length2*pi1
-                                        *(length2*mass2
-                                            *pi1*cos(phi1-phi2)
-                                            -pi2*(mass1+mass2))
-                                            *sin(phi1-phi2)
-                                            /pow((length1*length2*mass2
-                                                *pow(cos(phi1-phi2),2.0)
-                                                -mass1-mass2),2.0)+2.0
-                                                *pi1*pi2*sin(phi1-phi2)
-                                                /(length1*length2*mass2
-                                                    *pow(cos(phi1-phi2),2.0)
-                                                    -mass1-mass2)
-                                                    -(length1*pi2*
-                                                        cos(phi1-phi2)-pi1)
-                                                        *(length2*mass2*pi1
-                                                            *cos(phi1-phi2)
-                                                        -pi2*(mass1+mass2))
-                                                        *sin(phi1-phi2)
-                                                        /pow((length1
-                                                            *length2*mass2
-                                                            *pow(
-                                                                cos(phi1
-                                                                    -phi2),
-                                                                2.0)
-                                                            -mass1
-                                                            -mass2),2.0);
-        double dot_pi2 
-            = -gravity*length2*mass2
-            *sin(phi2)-4.0*length1
-            *length2*mass2*(0.5*mass1+0.5*mass2)
-            *pow((length1*pi2*cos(phi1-phi2)-pi1),2.0)
-            *sin(phi1-phi2)*cos(phi1-phi2)
-            /pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)
-            -mass1-mass2),3.0)-4.0*length1*length2*mass2
-            *(length1*pi2*cos(phi1-phi2)-pi1)
-            *(length2*mass2*pi1*cos(phi1-phi2)-pi2
-            *(mass1+mass2))*sin(phi1-phi2)
-            *pow(cos(phi1-phi2),2.0)
-            /pow((length1*length2*mass2
-                *pow(cos(phi1-phi2),2.0)-mass1-mass2),3.0)
-                -2.0*length1*length2
-                *pow((length2*mass2*pi1*cos(phi1-phi2)
-                -pi2*(mass1+mass2)),2.0)*sin(phi1-phi2)
-                *cos(phi1-phi2)
-                /pow((length1*length2*mass2*pow(cos(phi1-phi2),2.0)
-                -mass1-mass2),3.0)+2.0*length1*pi2
-                *(0.5*mass1+0.5*mass2)
-                *(length1*pi2*cos(phi1-phi2)-pi1)
-                *sin(phi1-phi2)
-                /pow((length1*length2*mass2
-                    *pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0)
-                    +3.0*length1*pi2*(length2*mass2*pi1
-                        *cos(phi1-phi2)-pi2*(mass1+mass2))
-                        *sin(phi1-phi2)*cos(phi1-phi2)
-                        /pow((length1*length2*mass2
-                            *pow(cos(phi1-phi2),2.0)-mass1-mass2),2.0)
-                            +3.0*length2*mass2*pi1
-                            *(length1*pi2*cos(phi1-phi2)-pi1)
-                            *sin(phi1-phi2)
-                            *cos(phi1-phi2)
-                            /pow((length1*length2
-                                *mass2*pow(cos(phi1-phi2),2.0)
-                                -mass1-mass2),2.0)
-                                +1.0*length2
-                                *pi1*(length2*mass2*pi1
-                                    *cos(phi1-phi2)-pi2*(mass1+mass2))
-                                    *sin(phi1-phi2)
-                                    /pow((length1*length2
-                                        *mass2*pow(cos(phi1-phi2)
-                                    ,2.0)-mass1-mass2),2.0)
-                                    -2.0*pi1*pi2*sin(phi1-phi2)
-                                    /(length1*length2*mass2
-                                        *pow(cos(phi1-phi2),2.0)
-                                        -mass1-mass2)
-                                        +(length1*pi2
-                                            *cos(phi1-phi2)-pi1)
-                                            *(length2*mass2*pi1
-                                                *cos(phi1-phi2)
-                                                -pi2*(mass1+mass2))
-                                                *sin(phi1-phi2)
-                                                /pow((length1*length2
-                                                    *mass2*pow(cos(phi1-phi2)
-                                                    ,2.0)-mass1-mass2),2.0);
-        dot_coords[i].pi1 = dot_pi1;
-        dot_coords[i].pi2 = dot_pi2;
-        dot_coords[i].phi1 = dot_phi1;
-        dot_coords[i].phi2 = dot_phi2;
-    }
-}
-
-void CPUIntegration::rk4_time_step(
-    DoublePendulumParams params, double dt
-) {
-    int size = this->coords.size();
-    for (int i = 0; i < size; i++)
-        this->rk4[0][i] = this->coords[i];
-    // q1
-    compute_double_pendulum_dots(
-        this->rk4[1], this->coords, params);
-    // q2
-    for (int i = 0; i < size; i++)
-        this->tmp_coords[i] = this->coords[i] + this->rk4[1][i]*(dt/2.0);
-    compute_double_pendulum_dots(this->rk4[1], this->tmp_coords, params);
-    // q3
-    for (int i = 0; i < size; i++)
-        this->tmp_coords[i] = this->coords[i] + this->rk4[2][i]*(dt/2.0);
-    compute_double_pendulum_dots(this->rk4[3], this->tmp_coords, params);
-    // q4
-    for (int i = 0; i < size; i++)
-        this->tmp_coords[i] = this->coords[i] + this->rk4[3][i]*(dt);
-    compute_double_pendulum_dots(this->rk4[4], this->tmp_coords, params);
-    for (int i = 0; i < size; i++)
-        this->coords[i] = this->rk4[0][i] + (
-            this->rk4[1][i] 
-            + this->rk4[2][i]*2.0 + this->rk4[3][i]*2.0 
-            + this->rk4[4][i])*(dt/6.0);
-}
-
-void CPUIntegration::transfer_to_quad(Quad &dst) {
-    for (int i = 0; i < this->coords.size(); i++) {
-        this->f_coords[4*i] = this->coords[i].pi1;
-        this->f_coords[4*i + 1] = this->coords[i].pi2;
-        this->f_coords[4*i + 2] = this->coords[i].phi1;
-        this->f_coords[4*i + 3] = this->coords[i].phi2;
-    }
-    dst.set_pixels((float *)&this->f_coords[0]);
-}
-
-
 static void add2(
     Quad &dst, const Quad &a, const Quad &b, 
     uint32_t add2_program) {
@@ -384,136 +232,226 @@ static void add2(
     );
 }
 
-static void forward_euler(
-    Quad &q1, const Quad &q0, const Quad &q0_dot, 
-    uint32_t forward_euler_program, float dt) {
-    q1.draw(
-        forward_euler_program,
+/* Each of the following takes a number of steps of its method from coord
+in a single pass, which keeps the pendulums in registers over all of the
+steps, and draws the result to dst. The pendulum parameters are read from the
+PhysicsParams uniform block. */
+static void double_pendulum_rk4_time_step(
+    Quad &dst, const Quad &coord,
+    const Programs &programs, float dt, int steps) {
+    const Program &rk4 = programs.rk4;
+    dst.draw(
+        rk4,
         {
-            {"dt", dt},
-            {"qTex", &q0},
-            {"qDotTex", &q0_dot},
-            {"weights", Vec4{.ind{1.0, 1.0, 1.0, 1.0}}}
+            {rk4.uniform_location("qTex"), &coord},
+            {rk4.uniform_location("dt"), dt},
+            {rk4.uniform_location("steps"), steps}
         }
     );
 }
 
-static void compute_double_pendulum_dots(
-    Quad &dot_q, const Quad &q, uint32_t double_pendulum_dots_program,
-    DoublePendulumParams params) {
-    dot_q.draw(
-        double_pendulum_dots_program,
+static void double_pendulum_gauss_legendre_time_step(
+    Quad &dst, const Quad &coord,
+    const Programs &programs, float dt, int steps) {
+    const Program &gauss_legendre = programs.gauss_legendre;
+    dst.draw(
+        gauss_legendre,
         {
-            {"coordinateTex", &q},
-            {"mass1", params.mass1},
-            {"mass2", params.mass2},
-            {"length1", params.length1},
-            {"length2", params.length2},
-            {"gravity", params.gravity}
+            {gauss_legendre.uniform_location("qTex"), &coord},
+            {gauss_legendre.uniform_location("dt"), dt},
+            {gauss_legendre.uniform_location("steps"), steps}
         }
     );
 }
 
-enum StepType {
-    STEP_X=0, STEP_P
-};
-
-struct SubStepWeight {
-    StepType type;
-    float value;
-};
-
-static void double_pendulum_symplectic_sub_step(
-    Quad &result, Quad &intermediate_quant, const Quad &input,
-    Programs programs,
-    DoublePendulumParams params,
-    SubStepWeight step_weight, float dt
-) {
-    uint32_t double_pendulum_program = programs.double_pendulum_dots;
-    compute_double_pendulum_dots(
-        intermediate_quant, 
-        input, double_pendulum_program, params);
-    result.draw(
-        programs.forward_euler,
+static void double_pendulum_extended_phase_space_time_step(
+    Quad &dst, const Quad &coord,
+    const Programs &programs, float dt, int steps) {
+    const Program &extended_phase_space = programs.extended_phase_space;
+    dst.draw(
+        extended_phase_space,
         {
-            {"dt", dt},
-            {"qTex", &input},
-            {"qDotTex", &intermediate_quant},
-            {"weights", 
-                (step_weight.type == STEP_X)?
-                    Vec4{.ind{0.0, 0.0, 
-                              step_weight.value, step_weight.value}}:
-                    Vec4{.ind{step_weight.value, step_weight.value,
-                               0.0, 0.0}}
-            }
+            {extended_phase_space.uniform_location("qTex"), &coord},
+            {extended_phase_space.uniform_location("dt"), dt},
+            {extended_phase_space.uniform_location("steps"), steps},
+            {extended_phase_space.uniform_location("omega"),
+             float(EXTENDED_PHASE_SPACE_BINDING)}
         }
     );
 }
 
-static void double_pendulum_rk4_time_step(
-    Quad &result, 
-    RK4Frames &rk4_frames, Quad &coord_intermediate,
-    const Quad &coord,
-    Programs programs, 
-    DoublePendulumParams params, float dt) {
-    uint32_t double_pendulum_program = programs.double_pendulum_dots;
-    rk4_frames.ind[0].draw(
-        programs.copy,
-        {{"tex", &coord}});
-    // q1
-    compute_double_pendulum_dots(
-        rk4_frames.ind[1], 
-        coord, double_pendulum_program, params);
-    // q2
-    forward_euler(
-        coord_intermediate, 
-        coord, rk4_frames.ind[1], programs.forward_euler, dt/2.0);
-    compute_double_pendulum_dots(
-        rk4_frames.ind[2], 
-        coord_intermediate, double_pendulum_program, params);
-    // q3
-    forward_euler(
-        coord_intermediate, 
-        coord, rk4_frames.ind[2], programs.forward_euler, dt/2.0);
-    compute_double_pendulum_dots(
-        rk4_frames.ind[3], 
-        coord_intermediate, double_pendulum_program, params);
-    // q4
-    forward_euler(
-        coord_intermediate, 
-        coord, rk4_frames.ind[3], programs.forward_euler, dt);
-    compute_double_pendulum_dots(
-        rk4_frames.ind[4],
-        coord_intermediate, double_pendulum_program, params);
-    result.draw(
-        programs.rk4,
+/* Take steps of the method given by integrator with the compute shader
+backend, where the coordinates are read from and written to the storage
+buffer bound to 0. If record_flips is set, the flip times are recorded in the
+storage buffer bound to 1 after every step, counting from time, and the
+pendulums that have flipped are no longer integrated. */
+static void double_pendulum_compute_time_step(
+    int width, int height, const Programs &programs,
+    int integrator, float dt, int steps,
+    bool record_flips, float time) {
+    const Program &integrate = programs.integrate_compute;
+    dispatch_compute(
+        integrate,
         {
-            {"qTex", &rk4_frames.ind[0]},
-            {"qDotTex1", &rk4_frames.ind[1]},
-            {"qDotTex2", &rk4_frames.ind[2]},
-            {"qDotTex3", &rk4_frames.ind[3]},
-            {"qDotTex4", &rk4_frames.ind[4]},
-            {"dt", dt}
+            {integrate.uniform_location("width"), width},
+            {integrate.uniform_location("height"), height},
+            {integrate.uniform_location("integrator"), integrator},
+            {integrate.uniform_location("dt"), dt},
+            {integrate.uniform_location("steps"), steps},
+            {integrate.uniform_location("omega"),
+             float(EXTENDED_PHASE_SPACE_BINDING)},
+            {integrate.uniform_location("recordFlips"), int(record_flips)},
+            {integrate.uniform_location("time"), time}
+        },
+        IVec3{.ind{
+            (width + COMPUTE_GROUP_SIZE - 1)/COMPUTE_GROUP_SIZE,
+            (height + COMPUTE_GROUP_SIZE - 1)/COMPUTE_GROUP_SIZE, 1}}
+    );
+}
+
+/* Draw to dst the flip times, with those of the pendulums of coords that
+have just flipped set to time. */
+static void record_flip_times(
+    Quad &dst, const Quad &flip_times, const Quad &coords,
+    const Programs &programs, float time) {
+    const Program &flip_time = programs.flip_time;
+    dst.draw(
+        flip_time,
+        {
+            {flip_time.uniform_location("coordTex"), &coords},
+            {flip_time.uniform_location("flipTimeTex"), &flip_times},
+            {flip_time.uniform_location("time"), time}
         }
     );
 }
 
+std::vector<LazyProgram *> Programs::physics_programs() {
+    return {
+        &this->rk4, &this->gauss_legendre, &this->extended_phase_space,
+        &this->double_pendulum_dots, &this->double_pendulum_line_view,
+        &this->double_pendulum_points_view,
+        &this->double_pendulum_circles_view, &this->density, &this->energy,
+        &this->integrate_compute
+    };
+}
+
+bool Programs::use_variants(const std::string &defines) {
+    if (defines == m_defines)
+        return true;
+    std::vector<LazyProgram *> programs = this->physics_programs();
+    if (defines.empty()) {
+        for (size_t i = 0; i < programs.size(); i++)
+            *programs[i] = m_uniform_programs[i];
+        m_defines = defines;
+        return true;
+    }
+    auto variants = m_variants.find(defines);
+    if (variants == m_variants.end()) {
+        std::vector<LazyProgram> new_variants {};
+        for (const LazyProgram &program: m_uniform_programs) {
+            new_variants.push_back(program.with_defines(defines));
+            new_variants.back().start();
+        }
+        variants = m_variants.insert({defines, new_variants}).first;
+    }
+    // Only the variants of the programs used so far are waited for, as
+    // the others may never be used. Without background compiling each
+    // variant is compiled when it is first used instead, as the uniform
+    // programs are.
+    if (parallel_shader_compile_supported())
+        for (size_t i = 0; i < programs.size(); i++)
+            if (programs[i]->is_made() && !variants->second[i].is_ready())
+                return false;
+    for (size_t i = 0; i < programs.size(); i++)
+        *programs[i] = variants->second[i];
+    m_defines = defines;
+    return true;
+}
+
 Simulation::Simulation(int width, int height, sim_2d::SimParams params) :
     m_programs (),
     m_frames (
         width, height, 
         params.gridWidth, params.gridHeight, 
         params.subGridWidth, params.subGridHeight),
-    m_cpu_int() {
-    m_frames.coords.draw(
-        m_programs.double_pendulum_init,
+    m_cpu_int(),
+    m_time(0.0),
+    m_coords_buffer(),
+    m_flip_times_buffer(),
+    m_display_coords_buffer(),
+    m_display_flip_times_buffer(),
+    m_probe_coords_buffer(),
+    m_compute(false),
+    m_physics_buffer(),
+    m_physics(),
+    m_graph(),
+    m_step_passes(0), m_view_passes(0), m_fade_passes(0),
+    m_fade_interval(1), m_views_since_fade(0),
+    m_coords(0), m_flip_times(0), m_trajectories(0), m_density(0),
+    m_main_render(0), m_probe_coords(0), m_compute_state(0),
+    m_probe(0), m_time_unit(0),
+    m_pass_dt(0.0), m_pass_steps(0),
+    m_physics_defines(), m_stable_updates(0) {
+    this->set_physics_params(
         {
-            {"minPhi1",float(PI*params.minPhi1)},
-            {"maxPhi1",float(PI*params.maxPhi1)},
-            {"minPhi2",float(PI*params.minPhi2)},
-            {"maxPhi2",float(PI*params.maxPhi2)}
-        }
-    );
+            .mass1=params.mass1,
+            .mass2=params.mass2,
+            .length1=params.length1,
+            .length2=params.length2,
+            .gravity=params.gravity,
+        });
+    m_physics_buffer.bind(PHYSICS_UNIFORM_BINDING);
+    this->init_config(params);
+}
+
+void Simulation::set_physics_params(const DoublePendulumParams &params) {
+    if (params.mass1 == m_physics.mass1 && params.mass2 == m_physics.mass2
+        && params.length1 == m_physics.length1
+        && params.length2 == m_physics.length2
+        && params.gravity == m_physics.gravity)
+        return;
+    PhysicsUniforms uniforms {
+        .mass1=params.mass1,
+        .mass2=params.mass2,
+        .length1=params.length1,
+        .length2=params.length2,
+        .gravity=params.gravity,
+        .padding={0.0F, 0.0F, 0.0F}
+    };
+    m_physics_buffer.set_data(&uniforms, sizeof(uniforms));
+    m_physics = params;
+}
+
+/* The programs that read the pendulum parameters from the uniform block
+are used while they change, and once they have stayed the same for
+PHYSICS_VARIANT_DELAY updates, variants with the parameters compiled in as
+constants are used instead, which the compiler can fold into the rest of
+the arithmetic. The delay keeps a slider being dragged from compiling a
+variant for every value that it passes over. */
+void Simulation::select_programs(const sim_2d::SimParams &params) {
+    char defines[512];
+    snprintf(defines, sizeof(defines),
+             "#define PHYSICS_CONSTANTS\n"
+             "#define mass1 float(%.9g)\n"
+             "#define mass2 float(%.9g)\n"
+             "#define length1 float(%.9g)\n"
+             "#define length2 float(%.9g)\n"
+             "#define gravity float(%.9g)\n"
+             "#define integrator %d\n"
+             "#define recordFlips %d\n",
+             double(m_physics.mass1), double(m_physics.mass2),
+             double(m_physics.length1), double(m_physics.length2),
+             double(m_physics.gravity),
+             params.integrator, int(params.flipTime));
+    if (m_physics_defines != defines) {
+        m_physics_defines = defines;
+        m_stable_updates = 0;
+        m_programs.use_variants("");
+    } else if (m_stable_updates < PHYSICS_VARIANT_DELAY) {
+        m_stable_updates++;
+    } else {
+        m_programs.use_variants(m_physics_defines);
+    }
 }
 
 void Simulation::init_config(sim_2d::SimParams params) {
@@ -539,6 +477,19 @@ void Simulation::init_config(sim_2d::SimParams params) {
             .min_filter=GL_NEAREST,
             .mag_filter=GL_NEAREST,
         };
+    m_time = 0.0;
+    m_compute = params.useGPU && params.useComputeShaders;
+    if (m_compute && m_programs.integrate_compute.get().get_id() == 0) {
+        fprintf(stderr, "Compute shaders are not supported, "
+                "falling back to fragment shaders.\n");
+        m_compute = false;
+    }
+    m_frames.flip_tex_params.width = params.gridWidth;
+    m_frames.flip_tex_params.height = params.gridHeight;
+    if (m_compute) {
+        this->init_compute_state(params);
+        return;
+    }
     m_frames.coords.reset(m_frames.sim_tex_params);
     m_frames.coords.draw(
         m_programs.double_pendulum_init,
@@ -549,26 +500,349 @@ void Simulation::init_config(sim_2d::SimParams params) {
             {"maxPhi2", float(PI*params.maxPhi2)}
         }
     );
-    // m_frames.sub_coords.reset(m_frames.sim_tex_params);
-    m_frames.tmp1.reset(m_frames.sim_tex_params);
-    m_frames.tmp2.reset(m_frames.sim_tex_params);
-    m_frames.tmp3.reset(m_frames.sim_tex_params);
-    for (int i = 0; i < 5; i++)
-        m_frames.rk4.ind[i].reset(m_frames.sim_tex_params);
-    m_frames.sub_coords.reset(m_frames.sub_tex_params);
-    IVec2 d_2d = IVec2{.ind{
+    m_frames.flip_times.reset(m_frames.flip_tex_params);
+    m_frames.flip_times.draw(
+        m_programs.uniform_color,
+        {{"color", Vec4{.ind{0.0, 0.0, 0.0, 0.0}}}});
+    this->record_passes(params);
+}
+
+/* The grid is only kept in the storage buffers, which unlike textures are
+not limited in size beyond the memory of the GPU, and the textures of
+m_frames only get the pendulums that are shown: one for each pixel of the
+grid view, where the grid is larger than it, and those of the probe. */
+void Simulation::init_compute_state(sim_2d::SimParams params) {
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    uint32_t display_size = std::min(
+        m_frames.main_view_tex_params.height, uint32_t(max_size));
+    TextureParams display_params = m_frames.sim_tex_params;
+    display_params.width = std::min(display_params.width, display_size);
+    display_params.height = std::min(display_params.height, display_size);
+    m_frames.coords.reset(display_params);
+    display_params.format = m_frames.flip_tex_params.format;
+    m_frames.flip_times.reset(display_params);
+    m_frames.probe_coords.reset(m_frames.sub_tex_params);
+    size_t size = size_t(params.gridWidth)*size_t(params.gridHeight);
+    m_coords_buffer.resize(4*sizeof(float)*size);
+    m_flip_times_buffer.resize(sizeof(float)*size);
+    size_t display_count
+        = size_t(display_params.width)*size_t(display_params.height);
+    m_display_coords_buffer.resize(4*sizeof(float)*display_count);
+    m_display_flip_times_buffer.resize(sizeof(float)*display_count);
+    m_probe_coords_buffer.resize(
+        4*sizeof(float)*size_t(params.subGridWidth)
+        *size_t(params.subGridHeight));
+    m_coords_buffer.bind(0);
+    m_flip_times_buffer.bind(1);
+    const Program &init = m_programs.init_compute;
+    dispatch_compute(
+        init,
+        {
+            {init.uniform_location("width"), params.gridWidth},
+            {init.uniform_location("height"), params.gridHeight},
+            {init.uniform_location("minPhi1"), float(PI*params.minPhi1)},
+            {init.uniform_location("maxPhi1"), float(PI*params.maxPhi1)},
+            {init.uniform_location("minPhi2"), float(PI*params.minPhi2)},
+            {init.uniform_location("maxPhi2"), float(PI*params.maxPhi2)}
+        },
+        IVec3{.ind{
+            (params.gridWidth + COMPUTE_GROUP_SIZE - 1)/COMPUTE_GROUP_SIZE,
+            (params.gridHeight + COMPUTE_GROUP_SIZE - 1)/COMPUTE_GROUP_SIZE,
+            1}}
+    );
+    this->record_passes(params);
+}
+
+/* Copy the shown pendulums from the storage buffers to the textures. */
+void Simulation::sample_compute_state(
+    Quad &coords, Quad &flip_times, Quad &probe_coords, Vec4 probe) {
+    IVec2 display_size {.ind{(int)coords.width(), (int)coords.height()}};
+    IVec2 probe_size {.ind{
+        (int)probe_coords.width(), (int)probe_coords.height()}};
+    m_coords_buffer.bind(0);
+    m_flip_times_buffer.bind(1);
+    m_display_coords_buffer.bind(2);
+    m_display_flip_times_buffer.bind(3);
+    m_probe_coords_buffer.bind(4);
+    int width = std::max(display_size[0], probe_size[0]);
+    int height = std::max(display_size[1], probe_size[1]);
+    const Program &sample = m_programs.sample_compute;
+    IVec2 grid_size {.ind{
+        (int)m_frames.sim_tex_params.width,
+        (int)m_frames.sim_tex_params.height}};
+    dispatch_compute(
+        sample,
+        {
+            {sample.uniform_location("gridSize"), grid_size},
+            {sample.uniform_location("displaySize"), display_size},
+            {sample.uniform_location("probe"), probe},
+            {sample.uniform_location("probeSize"), probe_size}
+        },
+        IVec3{.ind{
+            (width + COMPUTE_GROUP_SIZE - 1)/COMPUTE_GROUP_SIZE,
+            (height + COMPUTE_GROUP_SIZE - 1)/COMPUTE_GROUP_SIZE, 1}}
+    );
+    m_display_coords_buffer.copy_to(coords);
+    m_display_flip_times_buffer.copy_to(flip_times);
+    m_probe_coords_buffer.copy_to(probe_coords);
+}
+
+/* Each pass reads the current contents of the textures of m_frames, and
+draws to the texture given by the graph, which for the passes that read and
+write the same texture is a spare that is swapped in afterwards. */
+void Simulation::record_passes(sim_2d::SimParams params) {
+    typedef RenderGraph::PassContext PassContext;
+    m_graph.clear();
+    m_coords = m_graph.import(m_frames.coords);
+    m_flip_times = m_graph.import(m_frames.flip_times);
+    m_trajectories = m_graph.import(m_frames.trajectories);
+    m_density = m_graph.import(m_frames.density);
+    m_main_render = m_graph.import(m_frames.main_render);
+    m_probe = m_graph.create_value(Vec4{.ind{0.0, 0.0, 0.0, 0.0}});
+    m_time_unit = m_graph.create_value(Vec4{.ind{1.0, 0.0, 0.0, 0.0}});
+    m_step_passes = m_graph.add_sequence();
+    m_view_passes = m_graph.add_sequence();
+    m_fade_passes = m_graph.add_sequence();
+    m_fade_interval
+        = (m_frames.trajectories.get_params().format == GL_R11F_G11F_B10F)?
+            NARROW_TRAIL_FADE_INTERVAL: 1;
+    m_views_since_fade = 0;
+    // Where the probe views read the probed pendulums from, and which part
+    // of that they are in.
+    RenderGraph::Resource probe_coords = m_coords;
+    RenderGraph::Resource probe = m_probe;
+    if (m_compute) {
+        m_probe_coords = m_graph.import(m_frames.probe_coords);
+        m_compute_state = m_graph.create_value(
+            Vec4{.ind{0.0, 0.0, 0.0, 0.0}});
+        m_graph.add_pass(
+            m_view_passes, "sample storage buffers",
+            {m_compute_state, m_probe},
+            {m_coords, m_flip_times, m_probe_coords},
+            [this](PassContext &pass) {
+                this->sample_compute_state(
+                    pass.quad(m_coords), pass.quad(m_flip_times),
+                    pass.quad(m_probe_coords), pass.value(m_probe));
+            });
+        probe_coords = m_probe_coords;
+        probe = m_graph.create_value(Vec4{.ind{0.0, 0.0, 1.0, 1.0}});
+    }
+    // The CPU and compute shader backends step outside of the graph.
+    if (params.useGPU && !m_compute) {
+        // DOPRI5 is CPU only, and falls back to RK4 here.
+        void (*step)(Quad &, const Quad &, const Programs &, float, int);
+        switch(params.integrator) {
+            case INTEGRATOR_GAUSS_LEGENDRE:
+            step = ::double_pendulum_gauss_legendre_time_step;
+            break;
+            case INTEGRATOR_EXTENDED_PHASE_SPACE:
+            step = ::double_pendulum_extended_phase_space_time_step;
+            break;
+            default:
+            step = ::double_pendulum_rk4_time_step;
+            break;
+        }
+        m_graph.add_pass(
+            m_step_passes, "time step", {m_coords}, {m_coords},
+            [this, step](PassContext &pass) {
+                step(pass.quad(m_coords), m_frames.coords, m_programs,
+                     m_pass_dt, m_pass_steps);
+            });
+        // Only recorded here, as unlike on the CPU every pixel is
+        // integrated whether it has flipped or not.
+        if (params.flipTime)
+            m_graph.add_pass(
+                m_step_passes, "flip times",
+                {m_coords, m_flip_times}, {m_flip_times},
+                [this](PassContext &pass) {
+                    ::record_flip_times(
+                        pass.quad(m_flip_times), m_frames.flip_times,
+                        m_frames.coords, m_programs, float(m_time));
+                });
+    }
+    Config grid_viewport = Config::viewport(
+        0, 0,
+        m_frames.main_view_tex_params.height,
+        m_frames.main_view_tex_params.height);
+    Config probe_viewport = Config::viewport(
+        m_frames.main_view_tex_params.width/2.0, 0,
+        m_frames.main_view_tex_params.height,
+        m_frames.main_view_tex_params.height);
+    // Flips take longer for longer and slower pendulums, so their times
+    // are measured in units of sqrt(length1/gravity).
+    if (params.flipTime) {
+        m_graph.add_pass(
+            m_view_passes, "flip time colors",
+            {m_flip_times, m_time_unit}, {m_main_render},
+            [this, grid_viewport](PassContext &pass) {
+                pass.render_target(m_main_render).draw(
+                    m_programs.flip_time_color,
+                    {
+                        {"flipTimeTex", pass.input(m_flip_times)},
+                        {"timeUnit", pass.value(m_time_unit).x}
+                    },
+                    m_frames.quad_wire_frame, grid_viewport);
+            });
+    } else {
+        m_graph.add_pass(
+            m_view_passes, "colors", {m_coords}, {m_main_render},
+            [this, grid_viewport](PassContext &pass) {
+                pass.render_target(m_main_render).draw(
+                    m_programs.color,
+                    {
+                        {"viewScale", 0.25F},
+                        {"viewOffset", Vec2{.ind{0.0, 0.0}}},
+                        {"coordFragTex", pass.input(m_coords)}
+                    },
+                    m_frames.quad_wire_frame, grid_viewport);
+            });
+    }
+    m_graph.add_pass(
+        m_view_passes, "probe outline", {m_probe}, {m_main_render},
+        [this](PassContext &pass) {
+            Vec4 probe = pass.value(m_probe);
+            this->draw_square_outline(Vec2{.ind{probe.x, probe.y}});
+        });
+    // The probed pendulums are drawn straight from the coordinates, as
+    // instances whose shapes are built by the vertex shaders.
+    IVec2 probe_size {.ind{
         (int)m_frames.sub_tex_params.width,
         (int)m_frames.sub_tex_params.height}};
-    m_frames.double_pendulum_lines
-        = get_pendulum_lines_wire_frame(d_2d);
-    m_frames.double_pendulum_points
-        = get_pendulum_points_wire_frame(d_2d);
-    m_frames.double_pendulum_circles
-        = get_pendulum_circles_wire_frame(d_2d);
+    int probe_count = probe_size[0]*probe_size[1];
+    Instances circles {
+        .draw_type=WireFrame::TRIANGLES,
+        .vertex_count=2*CIRCLE_SEGMENTS*3,
+        .instance_count=probe_count
+    };
+    Instances lines {
+        .draw_type=WireFrame::LINES,
+        .vertex_count=4,
+        .instance_count=probe_count
+    };
+    Config probe_view_viewport = Config::viewport(
+        m_frames.main_view_tex_params.height, 0,
+        m_frames.main_view_tex_params.height,
+        m_frames.main_view_tex_params.height);
+    // For large probes, where the circles would only overdraw each other,
+    // every bob is instead added as a single point to a low resolution
+    // density, which costs the same however the pendulums are spread.
+    if (params.probeDensity) {
+        Instances bobs {
+            .draw_type=WireFrame::POINTS,
+            .vertex_count=2,
+            .instance_count=probe_count
+        };
+        m_graph.add_pass(
+            m_view_passes, "bob density",
+            {probe_coords, probe}, {m_density},
+            [this, probe_coords, probe, probe_size, bobs](
+                PassContext &pass) {
+                RenderTarget &density = pass.render_target(m_density);
+                density.clear();
+                Enables enables({GL_BLEND});
+                glBlendFunc(GL_ONE, GL_ONE);
+                density.draw(
+                    m_programs.density,
+                    {
+                        {"coordTex", pass.input(probe_coords)},
+                        {"probe", pass.input(probe)},
+                        {"probeSize", probe_size},
+                        {"color", Vec4{.ind{1.0, 0.0, 0.0, 0.0}}},
+                        {"viewScale", 0.4F},
+                        {"viewOffset", Vec2{.x=0.0, .y=0.0}},
+                        {"pointSize", 1.0F}
+                    },
+                    bobs
+                );
+            });
+        m_graph.add_pass(
+            m_view_passes, "bob density view", {m_density}, {m_main_render},
+            [this, probe_view_viewport](PassContext &pass) {
+                pass.render_target(m_main_render).draw(
+                    m_programs.density_color,
+                    {{"densityTex", pass.input(m_density)}},
+                    m_frames.quad_wire_frame,
+                    probe_view_viewport
+                );
+            });
+        return;
+    }
+    m_graph.add_pass(
+        m_view_passes, "trajectories",
+        {probe_coords, probe}, {m_trajectories},
+        [this, probe_coords, probe, probe_size, circles](PassContext &pass) {
+            pass.render_target(m_trajectories).draw(
+                m_programs.double_pendulum_circles_view,
+                {
+                    {"coordTex", pass.input(probe_coords)},
+                    {"probe", pass.input(probe)},
+                    {"probeSize", probe_size},
+                    {"viewScale", 0.4F},
+                    {"viewOffset", Vec2{.x=0.0, .y=0.0}},
+                    {"circleRadius", 0.005F},
+                    {"coordFragTex", pass.input(probe_coords)}
+                },
+                circles
+            );
+        });
+    m_graph.add_pass(
+        m_view_passes, "trajectories view",
+        {m_trajectories}, {m_main_render},
+        [this, probe_view_viewport](PassContext &pass) {
+            pass.render_target(m_main_render).draw(
+                m_programs.copy,
+                {
+                    {"tex", pass.input(m_trajectories)}
+                },
+                m_frames.quad_wire_frame,
+                probe_view_viewport
+            );
+        });
+    m_graph.add_pass(
+        m_view_passes, "pendulum lines",
+        {probe_coords, probe}, {m_main_render},
+        [this, probe_coords, probe, probe_viewport, probe_size, lines](
+            PassContext &pass) {
+            pass.render_target(m_main_render).draw(
+                m_programs.double_pendulum_line_view,
+                {
+                    {"coordTex", pass.input(probe_coords)},
+                    {"probe", pass.input(probe)},
+                    {"probeSize", probe_size},
+                    {"color", Vec4{.r=1.0, .g=1.0, .b=1.0, .a=1.0}},
+                    {"viewScale", 0.4F},
+                    {"viewOffset", Vec2{.x=0.0, .y=0.0}}
+                },
+                lines,
+                probe_viewport
+            );
+        });
+    // The trajectories fade by being drawn scaled onto a spare, which
+    // replaces them.
+    float fade = pow(TRAIL_FADE, m_fade_interval);
+    m_graph.add_pass(
+        m_fade_passes, "fade trajectories",
+        {m_trajectories}, {m_trajectories},
+        [this, fade](PassContext &pass) {
+            pass.render_target(m_trajectories).draw(
+                m_programs.scale,
+                {
+                    {"tex", pass.input(m_trajectories)},
+                    {"scale", fade}
+                    // {"scale", 0.9999F}
+                },
+                m_frames.quad_wire_frame
+            );
+        });
 }
 
+RenderGraph::PassCounts Simulation::take_pass_counts() {
+    return m_graph.take_pass_counts();
+}
 
-void Simulation::time_step(sim_2d::SimParams sim_params) {
+
+void Simulation::time_step(sim_2d::SimParams sim_params, int steps) {
     DoublePendulumParams params {
         .mass1=sim_params.mass1, 
         .mass2=sim_params.mass2,
@@ -577,60 +851,50 @@ void Simulation::time_step(sim_2d::SimParams sim_params) {
         .gravity=sim_params.gravity,
     };
     float dt = sim_params.dt;
-    // std::vector<SubStepWeight> weights = {
-    //     {STEP_P, 1.0}, 
-    //     {STEP_X, 1.0},
-    // std::vector<SubStepWeight> weights = {
-    //     {STEP_P, 0.5}, 
-    //     {STEP_X, 1.0},
-    //     {STEP_P, 0.5}};
-    // std::vector<SubStepWeight> weights = {
-    //     {STEP_X, 1.0},
-    //     {STEP_P, -1.0/24.0}, 
-    //     {STEP_X, -2.0/3.0},
-    //     {STEP_P, 3.0/4.0},
-    //     {STEP_X, 2.0/3.0},
-    //     {STEP_P, 7.0/24.0}
-    // };
-    // float third = 1.0/3.0;
-    // std::vector<SubStepWeight> weights = {
-    //     // 1
-    //     {STEP_X, (float)(1.0/(2.0*(2.0 - pow(2.0, third))))},
-    //     {STEP_P, (float)(1.0/(2.0 - pow(2.0, third)))}, 
-    //     // 2
-    //     {STEP_X, (float)((1.0 - pow(2.0, third))/(2.0*(2.0 - pow(2.0, third))))},
-    //     {STEP_P, (float)(-pow(2.0, third)/(2.0 - pow(2.0, third)))},
-    //     // 3
-    //     {STEP_X, (float)((1.0 - pow(2.0, third))/(2.0*(2.0 - pow(2.0, third))))},
-    //     {STEP_P, (float)(1.0/(2.0 - pow(2.0, third)))}, 
-    //     // 4
-    //     {STEP_X, (float)(1.0/(2.0*(2.0 - pow(2.0, third))))} 
-    // };
-    /* for (int k = weights.size() - 1; k >= 0; k--) {
-        SubStepWeight weight = weights[k];
-        double_pendulum_symplectic_sub_step(
-            (k == 0)? 
-                m_frames.coords: ((k % 2)? m_frames.tmp3: m_frames.tmp2),  
-            m_frames.tmp1, 
-            (k == (weights.size() - 1))? 
-                m_frames.coords: ((k % 2)? m_frames.tmp2: m_frames.tmp3), 
-            m_programs, params, weight, dt);
-    }*/
     if (!sim_params.useGPU) {
-        m_cpu_int.rk4_time_step(params, dt);
+        m_cpu_int.set_threads(sim_params.cpuThreads, sim_params.pinCPUThreads);
+        m_cpu_int.set_tolerance(pow(10.0, sim_params.cpuToleranceExponent));
+        m_cpu_int.time_step(params, dt, steps);
         return;
     }
-    ::double_pendulum_rk4_time_step(
-        m_frames.coords, m_frames.rk4, m_frames.tmp1, m_frames.coords,
-        m_programs, params, dt);
+    this->set_physics_params(params);
+    this->select_programs(sim_params);
+    if (m_compute) {
+        // Flips are recorded after every step within a pass here, so the
+        // passes are as long in the flip time mode as outside of it.
+        m_coords_buffer.bind(0);
+        m_flip_times_buffer.bind(1);
+        for (int i = 0; i < steps; i += MAX_GPU_STEPS_PER_PASS) {
+            int pass_steps = std::min(MAX_GPU_STEPS_PER_PASS, steps - i);
+            ::double_pendulum_compute_time_step(
+                m_frames.sim_tex_params.width, m_frames.sim_tex_params.height,
+                m_programs, sim_params.integrator, dt, pass_steps,
+                sim_params.flipTime, float(m_time));
+            m_time += pass_steps*std::abs(dt);
+        }
+        m_graph.touch(m_compute_state);
+        return;
+    }
+    // In the flip time mode, the flips are recorded between passes, so
+    // every pass takes a single step.
+    int steps_per_pass
+        = (sim_params.flipTime)? 1: MAX_GPU_STEPS_PER_PASS;
+    for (int i = 0; i < steps; i += steps_per_pass) {
+        m_pass_dt = dt;
+        m_pass_steps = std::min(steps_per_pass, steps - i);
+        if (sim_params.flipTime)
+            m_time += std::abs(dt);
+        m_graph.replay(m_step_passes);
+    }
 }
 
 void Simulation::clear_view() {
     // m_frames.main_render.clear();
-    m_frames.trajectories1.clear();
+    m_frames.trajectories.clear();
+    m_graph.touch(m_trajectories);
 }
 
-void Simulation::draw_square_outline(sim_2d::SimParams sim_params) {
+void Simulation::draw_square_outline(Vec2 position) {
     float x_sub_width 
     = float(m_frames.sub_tex_params.width)
         /float(m_frames.sim_tex_params.width);
@@ -645,11 +909,11 @@ void Simulation::draw_square_outline(sim_2d::SimParams sim_params) {
             },
             m_frames.quad_wire_frame,
             Config::viewport(
-                int(sim_params.pendulumDisplayWithInitialAngles.x
+                int(position.x
                     *m_frames.main_view_tex_params.width/2.0
                     + ((i != 3)? 
                     0: x_sub_width*m_frames.main_view_tex_params.height)),
-                int(sim_params.pendulumDisplayWithInitialAngles.y
+                int(position.y
                     *m_frames.main_view_tex_params.height
                     + ((i != 2)?
                     0: y_sub_height*m_frames.main_view_tex_params.height)),
@@ -663,8 +927,12 @@ void Simulation::draw_square_outline(sim_2d::SimParams sim_params) {
 }
 
 const RenderTarget &Simulation::view(sim_2d::SimParams sim_params) {
-    if (!sim_params.useGPU)
+    if (!sim_params.useGPU) {
         m_cpu_int.transfer_to_quad(m_frames.coords);
+        m_cpu_int.transfer_flip_times_to_quad(m_frames.flip_times);
+        m_graph.touch(m_coords);
+        m_graph.touch(m_flip_times);
+    }
     DoublePendulumParams params {
         .mass1=sim_params.mass1,
         .mass2=sim_params.mass2,
@@ -672,119 +940,27 @@ const RenderTarget &Simulation::view(sim_2d::SimParams sim_params) {
         .length2=sim_params.length2,
         .gravity=sim_params.gravity,
     };
-    // m_frames.main_render.clear();
-    m_frames.main_render.draw(
-        m_programs.color,
-        // m_programs.energy,
-        // m_programs.double_pendulum_line_view,
-        {
-            // {"coordTex", &m_frames.coords},
-            {"mass1", params.mass1},
-            {"mass2", params.mass2},
-            {"length1", params.length1},
-            {"length2", params.length2},
-            {"gravity", params.gravity},
-            {"viewScale", 0.25F},
-            {"viewOffset", Vec2{.ind{0.0, 0.0}}},
-            {"coordFragTex", &m_frames.coords}
-        },
-        m_frames.quad_wire_frame,
-        Config::viewport(
-            0, 0,
-            m_frames.main_view_tex_params.height, 
-            m_frames.main_view_tex_params.height
-        )
-        // m_frames.double_pendulum_lines
-    );
+    this->set_physics_params(params);
+    this->select_programs(sim_params);
     float x_sub_width 
         = float(m_frames.sub_tex_params.width)
             /float(m_frames.sim_tex_params.width);
     float y_sub_height
          = float(m_frames.sub_tex_params.height)
             /float(m_frames.sim_tex_params.height);
-    draw_square_outline(sim_params);
-    m_frames.sub_coords.draw(
-        m_programs.sub_window,
-        {
-            {"tex", &m_frames.coords},
-            {"viewport", Vec4{.ind{
-                sim_params.pendulumDisplayWithInitialAngles.x,
-                sim_params.pendulumDisplayWithInitialAngles.y, 
-                x_sub_width, 
-                y_sub_height}}}
-        }
-    );
-    m_frames.trajectories1.draw(
-        // m_programs.color,
-        // m_programs.energy,
-        m_programs.double_pendulum_circles_view,
-        {
-            {"coordTex", &m_frames.sub_coords},
-            {"mass1", params.mass1},
-            {"mass2", params.mass2},
-            {"length1", params.length1},
-            {"length2", params.length2},
-            {"gravity", params.gravity},
-            {"viewScale", 0.4F},
-            {"viewOffset", Vec2{.x=0.0, .y=0.0}},
-            {"circleRadius", 0.005F},
-            {"coordFragTex", &m_frames.sub_coords}
-        },
-        // m_frames.quad_wire_frame,
-        m_frames.double_pendulum_circles
-        // Config::viewport(1440, 0, 1440, 1440)
-    );
-    m_frames.main_render.draw(
-        m_programs.copy,
-        {
-            {"tex", &m_frames.trajectories1}
-        },
-        m_frames.quad_wire_frame,
-        Config::viewport(
-            m_frames.main_view_tex_params.height, 0, 
-            m_frames.main_view_tex_params.height,
-            m_frames.main_view_tex_params.height)
-    );
-    m_frames.main_render.draw(
-        // m_programs.color,
-        // m_programs.energy,
-        m_programs.double_pendulum_line_view,
-        {
-            {"coordTex", &m_frames.sub_coords},
-            {"mass1", params.mass1},
-            {"mass2", params.mass2},
-            {"length1", params.length1},
-            {"length2", params.length2},
-            {"gravity", params.gravity},
-            {"color", Vec4{.r=1.0, .g=1.0, .b=1.0, .a=1.0}},
-            {"viewScale", 0.4F},
-            {"viewOffset", Vec2{.x=0.0, .y=0.0}},
-            {"circleRadius", 0.005F},
-            {"coordFragTex", &m_frames.sub_coords}
-        },
-        // m_frames.quad_wire_frame,
-        m_frames.double_pendulum_lines,
-        Config::viewport(
-            m_frames.main_view_tex_params.width/2.0, 0, 
-            m_frames.main_view_tex_params.height,
-            m_frames.main_view_tex_params.height)
-    );
-    m_frames.trajectories2.draw(
-        m_programs.scale,
-        {
-            {"tex", &m_frames.trajectories1},
-            {"scale", 0.996F}
-            // {"scale", 0.9999F}
-        },
-        m_frames.quad_wire_frame
-    );
-    m_frames.trajectories1.draw(
-        m_programs.copy,
-        {
-            {"tex", &m_frames.trajectories2},
-        },
-        m_frames.quad_wire_frame
-    );
+    m_graph.set_value(m_probe, Vec4{.ind{
+        sim_params.pendulumDisplayWithInitialAngles.x,
+        sim_params.pendulumDisplayWithInitialAngles.y, 
+        x_sub_width, 
+        y_sub_height}});
+    m_graph.set_value(m_time_unit, Vec4{.ind{
+        (params.gravity > 0.0)?
+            float(sqrt(params.length1/params.gravity)): 1.0F,
+        0.0, 0.0, 0.0}});
+    m_graph.replay(m_view_passes);
+    if (++m_views_since_fade >= m_fade_interval) {
+        m_graph.replay(m_fade_passes);
+        m_views_since_fade = 0;
+    }
     return m_frames.main_render;
 }
-
@@ -3,33 +3,28 @@
 
 #include "gl_wrappers.hpp"
 #include "parameters.hpp"
+#include "cpu_integration.hpp"
+#include "render_graph.hpp"
 
 
-struct DoublePendulumParams {
-    float mass1, mass2;
-    float length1, length2;
-    float gravity;
-};
-
-struct RK4Frames {
-    Quad ind[5];
-};
-
 struct Frames {
     TextureParams main_view_tex_params;
     TextureParams sim_tex_params;
+    // Only the size of the probed part of the grid, which has no texture
+    // of its own.
     TextureParams sub_tex_params;
+    TextureParams flip_tex_params;
     Quad tmp0;
     RenderTarget main_render;
-    RenderTarget trajectories1;
-    RenderTarget trajectories2;
+    RenderTarget trajectories;
+    // Number of bobs of the probed pendulums on each texel, drawn instead
+    // of their trajectories if probeDensity is set.
+    RenderTarget density;
+    // With the compute shader backend, these only hold as much of the
+    // grid as is shown, and probe_coords the probed pendulums.
     Quad coords;
-    Quad sub_coords;
-    Quad tmp1, tmp2, tmp3;
-    RK4Frames rk4;
-    WireFrame double_pendulum_lines;
-    WireFrame double_pendulum_points;
-    WireFrame double_pendulum_circles;
+    Quad flip_times;
+    Quad probe_coords;
     WireFrame quad_wire_frame;
     Frames(
         int window_width, int window_height,
@@ -39,74 +34,114 @@ struct Frames {
 };
 
 struct Programs {
-    uint32_t copy;
-    uint32_t scale;
-    uint32_t uniform_color;
-    uint32_t sub_window;
-    uint32_t draw_square;
-    uint32_t forward_euler;
-    uint32_t rk4;
-    uint32_t double_pendulum_init;
-    uint32_t double_pendulum_dots;
-    uint32_t double_pendulum_line_view;
-    uint32_t double_pendulum_points_view;
-    uint32_t double_pendulum_circles_view;
-    uint32_t color;
-    uint32_t energy;
+    LazyProgram copy;
+    LazyProgram scale;
+    LazyProgram uniform_color;
+    LazyProgram draw_square;
+    LazyProgram forward_euler;
+    LazyProgram rk4;
+    LazyProgram gauss_legendre;
+    LazyProgram extended_phase_space;
+    LazyProgram double_pendulum_init;
+    LazyProgram double_pendulum_dots;
+    LazyProgram double_pendulum_line_view;
+    LazyProgram double_pendulum_points_view;
+    LazyProgram double_pendulum_circles_view;
+    LazyProgram color;
+    LazyProgram energy;
+    LazyProgram flip_time;
+    LazyProgram flip_time_color;
+    LazyProgram density;
+    LazyProgram density_color;
+    // Made as Program() if compute shaders are not supported.
+    LazyProgram integrate_compute;
+    LazyProgram init_compute;
+    LazyProgram sample_compute;
+    /* Where the context can compile shaders in the background, every
+    program starts compiling at once, and otherwise each is compiled when it
+    is first used. */
     Programs();
-};
-
-class CPUIntegration {
-    struct Coord {
-        double pi1;
-        double pi2;
-        double phi1;
-        double phi2;
-        Coord operator*(double a) {
-            return {
-                .pi1 = a*this->pi1,
-                .pi2 = a*this->pi2,
-                .phi1 = a*this->phi1,
-                .phi2 = a*this->phi2,
-            };
-        }
-        Coord operator+(Coord a) {
-            return {
-                .pi1 = this->pi1 + a.pi1,
-                .pi2 = this->pi2 + a.pi2,
-                .phi1 = this->phi1 + a.phi1,
-                .phi2 = this->phi2 + a.phi2,
-            };
-        }
-    };
-    std::vector<float> f_coords;
-    std::vector<Coord> coords;
-    std::vector<Coord> tmp_coords;
-    std::vector<std::vector<Coord>> rk4;
-    void compute_double_pendulum_dots(
-        std::vector<Coord> &dot_coords,
-        const std::vector<Coord> &coords,
-        DoublePendulumParams params);
-    public:
-    CPUIntegration();
-    void init_config(sim_2d::SimParams params);
-    void rk4_time_step(
-        DoublePendulumParams params, double dt);
-    void transfer_to_quad(Quad &dst);
-    
+    /* Swap the programs that read the pendulum parameters for variants
+    compiled with the given #defines in front of their shaders, or back to
+    the programs that read them from the uniform block if defines is empty.
+    Variants are kept for each set of defines. Where the context compiles
+    in the background, the current programs are kept and false is returned
+    until the variants of those that have been used have finished
+    compiling. */
+    bool use_variants(const std::string &defines);
+    private:
+    std::vector<LazyProgram *> physics_programs();
+    // The physics programs as first made, and their variants.
+    std::vector<LazyProgram> m_uniform_programs;
+    std::map<std::string, std::vector<LazyProgram>> m_variants;
+    std::string m_defines;
 };
 
 class Simulation {
     Programs m_programs;
     Frames m_frames;
     CPUIntegration m_cpu_int;
-    void draw_square_outline(sim_2d::SimParams params);
+    // Time since init_config, for the flip times recorded on the GPU.
+    double m_time;
+    // State of the compute shader backend, which is only used if
+    // m_compute is set. The coordinates and flip times of the whole grid
+    // are laid out row by row, as the pixels of a texture of its size.
+    StorageBuffer m_coords_buffer;
+    StorageBuffer m_flip_times_buffer;
+    // The shown pendulums, picked out from the two above before every view
+    // that follows a time step, and copied to the textures of m_frames.
+    StorageBuffer m_display_coords_buffer;
+    StorageBuffer m_display_flip_times_buffer;
+    StorageBuffer m_probe_coords_buffer;
+    bool m_compute;
+    // Holds the pendulum parameters for every program that uses them,
+    // which are only uploaded again when they change.
+    UniformBuffer m_physics_buffer;
+    DoublePendulumParams m_physics;
+    // Passes of time_step and view over the textures of m_frames, which
+    // are recorded again on every call to init_config.
+    RenderGraph m_graph;
+    RenderGraph::Sequence m_step_passes;
+    RenderGraph::Sequence m_view_passes;
+    // Replayed after every m_fade_interval replays of m_view_passes.
+    RenderGraph::Sequence m_fade_passes;
+    int m_fade_interval;
+    int m_views_since_fade;
+    RenderGraph::Resource m_coords;
+    RenderGraph::Resource m_flip_times;
+    RenderGraph::Resource m_trajectories;
+    RenderGraph::Resource m_density;
+    RenderGraph::Resource m_main_render;
+    // Only used with the compute shader backend, where the storage buffers
+    // are a value that is touched on every time step.
+    RenderGraph::Resource m_probe_coords;
+    RenderGraph::Resource m_compute_state;
+    // The position and size of the probed part of the grid, and the unit
+    // of the flip times.
+    RenderGraph::Resource m_probe;
+    RenderGraph::Resource m_time_unit;
+    // Time step and number of steps of the next replay of m_step_passes.
+    float m_pass_dt;
+    int m_pass_steps;
+    // The #defines of the pendulum parameters at the last update, and the
+    // number of updates since they last changed.
+    std::string m_physics_defines;
+    int m_stable_updates;
+    void set_physics_params(const DoublePendulumParams &params);
+    void select_programs(const sim_2d::SimParams &params);
+    void init_compute_state(sim_2d::SimParams params);
+    void sample_compute_state(
+        Quad &coords, Quad &flip_times, Quad &probe_coords, Vec4 probe);
+    void record_passes(sim_2d::SimParams params);
+    void draw_square_outline(Vec2 position);
     public:
     Simulation(int window_width, int window_height, sim_2d::SimParams params);
-    void time_step(sim_2d::SimParams params);
+    void time_step(sim_2d::SimParams params, int steps=1);
     void clear_view();
     const RenderTarget &view(sim_2d::SimParams params);
     void init_config(sim_2d::SimParams params);
+    /* Passes of the render graph run and skipped since the last call. */
+    RenderGraph::PassCounts take_pass_counts();
 };
 
 #endif
\ No newline at end of file
@@ -122,19 +122,29 @@ function createEntryBoxes(
 
 let controls = document.getElementById('controls');
 createCheckbox(controls, 0, "Numerical integration on GPU", true);
-createScalarParameterSlider(controls, 1, "Steps/frame", "int", {'value': 10, 'min': 0, 'max': 100});
-createScalarParameterSlider(controls, 2, "Time step (s)", "float", {'value': 0.001, 'min': -0.01, 'max': 0.01, 'step': 0.0001});
-createScalarParameterSlider(controls, 3, "Mass 1 (kg)", "float", {'value': 1.0, 'min': 0.1, 'max': 10.0, 'step': 0.01});
-createScalarParameterSlider(controls, 4, "Length 1 (m)", "float", {'value': 1.0, 'min': 0.1, 'max': 2.0, 'step': 0.01});
-createScalarParameterSlider(controls, 5, "Mass 2 (kg)", "float", {'value': 1.0, 'min': 0.1, 'max': 10.0, 'step': 0.01});
-createScalarParameterSlider(controls, 6, "Length 2 (m)", "float", {'value': 1.0, 'min': 0.1, 'max': 2.0, 'step': 0.01});
-createScalarParameterSlider(controls, 7, "Acceleration due to gravity (m/s²)", "float", {'value': 9.81, 'min': 0.0, 'max': 20.0, 'step': 0.01});
-createScalarParameterSlider(controls, 9, "Min. initial angle 1 (# of π radians)", "float", {'value': -1.0, 'min': -1.0, 'max': 1.0, 'step': 0.01});
-createScalarParameterSlider(controls, 10, "Max. initial angle 1 (# of π radians)", "float", {'value': 1.0, 'min': -1.0, 'max': 1.0, 'step': 0.01});
-createScalarParameterSlider(controls, 11, "Min. initial angle 2 (# of π radians)", "float", {'value': -1.0, 'min': -1.0, 'max': 1.0, 'step': 0.01});
-createScalarParameterSlider(controls, 12, "Max. initial angle 2 (# of π radians)", "float", {'value': 1.0, 'min': -1.0, 'max': 1.0, 'step': 0.01});
-createScalarParameterSlider(controls, 13, "Angle 1 discretization size", "int", {'value': 128, 'min': 32, 'max': 2048});
-createScalarParameterSlider(controls, 14, "Angle 2 discretization size", "int", {'value': 128, 'min': 32, 'max': 2048});
-createScalarParameterSlider(controls, 15, "Sub sample width", "int", {'value': 1, 'min': 1, 'max': 1024});
-createScalarParameterSlider(controls, 16, "Sub sample height", "int", {'value': 1, 'min': 1, 'max': 1024});
+createCheckbox(controls, 1, "Integrate with compute shaders on GPU (OpenGL 4.3 / ES 3.1)", false);
+createScalarParameterSlider(controls, 2, "CPU integration threads (0 = all cores)", "int", {'value': 0, 'min': 0, 'max': 64});
+createCheckbox(controls, 3, "Pin CPU integration threads to cores", false);
+createScalarParameterSlider(controls, 4, "CPU integration precision (0 = float, 1 = double, 2 = long double)", "int", {'value': 1, 'min': 0, 'max': 2});
+createScalarParameterSlider(controls, 5, "Integrator (0 = RK4, 1 = Gauss-Legendre, 2 = extended phase space, 3 = adaptive Dormand-Prince 5(4), CPU only)", "int", {'value': 0, 'min': 0, 'max': 3});
+createScalarParameterSlider(controls, 6, "Adaptive step tolerance (10^n)", "int", {'value': -9, 'min': -14, 'max': -3});
+createCheckbox(controls, 7, "Colour by time until either arm first flips", false);
+createScalarParameterSlider(controls, 8, "Steps/frame (0 = fixed, 1 = fit to the target frame time, 2 = uncapped)", "int", {'value': 1, 'min': 0, 'max': 2});
+createScalarParameterSlider(controls, 9, "Fixed steps/frame", "int", {'value': 10, 'min': 0, 'max': 100});
+createScalarParameterSlider(controls, 10, "Target frame time (ms)", "float", {'value': 16.7, 'min': 4.0, 'max': 100.0, 'step': 0.1});
+createScalarParameterSlider(controls, 11, "Time step (s)", "float", {'value': 0.001, 'min': -0.01, 'max': 0.01, 'step': 0.0001});
+createScalarParameterSlider(controls, 12, "Mass 1 (kg)", "float", {'value': 1.0, 'min': 0.1, 'max': 10.0, 'step': 0.01});
+createScalarParameterSlider(controls, 13, "Length 1 (m)", "float", {'value': 1.0, 'min': 0.1, 'max': 2.0, 'step': 0.01});
+createScalarParameterSlider(controls, 14, "Mass 2 (kg)", "float", {'value': 1.0, 'min': 0.1, 'max': 10.0, 'step': 0.01});
+createScalarParameterSlider(controls, 15, "Length 2 (m)", "float", {'value': 1.0, 'min': 0.1, 'max': 2.0, 'step': 0.01});
+createScalarParameterSlider(controls, 16, "Acceleration due to gravity (m/s²)", "float", {'value': 9.81, 'min': 0.0, 'max': 20.0, 'step': 0.01});
+createScalarParameterSlider(controls, 18, "Min. initial angle 1 (# of π radians)", "float", {'value': -1.0, 'min': -1.0, 'max': 1.0, 'step': 0.01});
+createScalarParameterSlider(controls, 19, "Max. initial angle 1 (# of π radians)", "float", {'value': 1.0, 'min': -1.0, 'max': 1.0, 'step': 0.01});
+createScalarParameterSlider(controls, 20, "Min. initial angle 2 (# of π radians)", "float", {'value': -1.0, 'min': -1.0, 'max': 1.0, 'step': 0.01});
+createScalarParameterSlider(controls, 21, "Max. initial angle 2 (# of π radians)", "float", {'value': 1.0, 'min': -1.0, 'max': 1.0, 'step': 0.01});
+createScalarParameterSlider(controls, 22, "Angle 1 discretization size", "int", {'value': 128, 'min': 32, 'max': 2048});
+createScalarParameterSlider(controls, 23, "Angle 2 discretization size", "int", {'value': 128, 'min': 32, 'max': 2048});
+createScalarParameterSlider(controls, 24, "Sub sample width", "int", {'value': 1, 'min': 1, 'max': 1024});
+createScalarParameterSlider(controls, 25, "Sub sample height", "int", {'value': 1, 'min': 1, 'max': 1024});
+createCheckbox(controls, 26, "Show the sub sample as the density of its bobs", false);
 
@@ -0,0 +1,150 @@
+#include "thread_pool.hpp"
+#include <cstdio>
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define THREAD_POOL_NO_THREADS
+#endif
+
+static int hardware_thread_count() {
+    #ifdef THREAD_POOL_NO_THREADS
+    return 1;
+    #else
+    int count = std::thread::hardware_concurrency();
+    return (count > 0)? count: 1;
+    #endif
+}
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+static void pin_to_core(pthread_t handle, int core) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core % hardware_thread_count(), &cpu_set);
+    if (pthread_setaffinity_np(handle, sizeof(cpu_set_t), &cpu_set) != 0)
+        fprintf(stderr, "Unable to pin worker thread to core %d.\n", core);
+}
+#else
+// Thread affinity is only a hint on the other supported platforms
+// (and is not exposed at all on macOS), so pinning is skipped.
+template <typename Handle>
+static void pin_to_core(Handle handle, int core) {}
+#endif
+
+ThreadPool::ThreadPool(int thread_count, bool pin):
+    m_task(NULL), m_generation(0), m_busy(0), m_stop(false), m_pinned(pin) {
+    if (thread_count <= 0)
+        thread_count = hardware_thread_count();
+    #ifdef THREAD_POOL_NO_THREADS
+    thread_count = 1;
+    #endif
+    for (int i = 0; i < thread_count; i++)
+        m_workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    for (int i = 1; i < thread_count; i++) {
+        m_threads.push_back(std::thread(&ThreadPool::worker_loop, this, i));
+        if (pin)
+            pin_to_core(m_threads.back().native_handle(), i);
+    }
+}
+
+int ThreadPool::size() const {
+    return m_workers.size();
+}
+
+bool ThreadPool::pinned() const {
+    return m_pinned;
+}
+
+bool ThreadPool::next_chunk(int worker_index, size_t &chunk) {
+    {
+        Worker &own = *m_workers[worker_index];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.chunks.empty()) {
+            chunk = own.chunks.front();
+            own.chunks.pop_front();
+            return true;
+        }
+    }
+    int count = m_workers.size();
+    for (int i = 1; i < count; i++) {
+        Worker &victim = *m_workers[(worker_index + i) % count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.back();
+            victim.chunks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(
+    int worker_index, const std::function<void(size_t)> &task) {
+    size_t chunk;
+    while (next_chunk(worker_index, chunk))
+        task(chunk);
+}
+
+void ThreadPool::worker_loop(int worker_index) {
+    size_t seen_generation = 0;
+    std::unique_lock<std::mutex> lock(m_lock);
+    for (;;) {
+        m_start.wait(lock, [&] {
+            return m_stop || m_generation != seen_generation;
+        });
+        if (m_stop)
+            return;
+        seen_generation = m_generation;
+        const std::function<void(size_t)> *task = m_task;
+        // Woken up only after that run() already returned.
+        if (task == NULL)
+            continue;
+        m_busy++;
+        lock.unlock();
+        work(worker_index, *task);
+        lock.lock();
+        if (--m_busy == 0)
+            m_done.notify_all();
+    }
+}
+
+void ThreadPool::run(
+    size_t chunk_count, const std::function<void(size_t)> &task) {
+    int count = m_workers.size();
+    if (count == 1 || chunk_count == 1) {
+        for (size_t i = 0; i < chunk_count; i++)
+            task(i);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_lock);
+    for (int w = 0; w < count; w++) {
+        Worker &worker = *m_workers[w];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        for (size_t i = (w*chunk_count)/count;
+             i < ((w + 1)*chunk_count)/count; i++)
+            worker.chunks.push_back(i);
+    }
+    m_task = &task;
+    m_generation++;
+    m_busy++;
+    lock.unlock();
+    m_start.notify_all();
+    work(0, task);
+    lock.lock();
+    m_busy--;
+    m_done.wait(lock, [&] { return m_busy == 0; });
+    m_task = NULL;
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stop = true;
+    }
+    m_start.notify_all();
+    for (auto &thread: m_threads)
+        thread.join();
+}
@@ -0,0 +1,58 @@
+/* Persistent pool of worker threads for the CPU integrator.
+
+Work is handed to the pool as a number of chunks (for the integrator, bands of
+grid rows). The chunks are first split evenly into per-worker deques; a
+worker pops chunks from the front of its own deque, and once that is empty
+steals from the back of the others. This keeps neighbouring chunks on the same
+thread while still balancing the load when some chunks are much more
+expensive than others.
+
+The thread calling run() participates as worker 0, so a pool of size 1
+spawns no threads and just runs every chunk in place.
+*/
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+#ifndef _THREAD_POOL_
+#define _THREAD_POOL_
+
+class ThreadPool {
+    struct Worker {
+        std::mutex lock;
+        std::deque<size_t> chunks;
+    };
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    std::mutex m_lock;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    const std::function<void(size_t)> *m_task;
+    size_t m_generation;
+    int m_busy;
+    bool m_stop;
+    bool m_pinned;
+    bool next_chunk(int worker_index, size_t &chunk);
+    void work(int worker_index, const std::function<void(size_t)> &task);
+    void worker_loop(int worker_index);
+    ThreadPool(const ThreadPool &);
+    ThreadPool& operator=(const ThreadPool &);
+    public:
+    /* A thread_count of 0 uses every hardware thread. If pin is set,
+    worker i is bound to core i for every thread the pool creates, while
+    the calling thread, worker 0, is left free to run anywhere, as it also
+    has to drive the GPU and the UI. */
+    ThreadPool(int thread_count=0, bool pin=false);
+    int size() const;
+    bool pinned() const;
+    /* Call task(chunk) once for every chunk in [0, chunk_count),
+    spread over the pool, and return when all of them are done. */
+    void run(size_t chunk_count, const std::function<void(size_t)> &task);
+    ~ThreadPool();
+};
+
+#endif